@@ -22,29 +22,241 @@
 
 #include "4DALoader.h"
 
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "TextScanner.h"
+
 #include "json/json.hpp"
 
 #include "opencv2/opencv.hpp"
 
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 
-MultiViews T4DALoader::loadDataset(const std::string& path) {
-	std::ifstream stream(path + "/calibration.json", std::fstream::in);
+/* detections of one camera for every frame, values and PAFs are contiguous across frames */
+class T4DAViewData {
+public:
+	/* typeNum per frame */
+	std::vector<int> jointNums;
+	
+	/* u, v and confidence blocks of every joint type */
+	std::vector<float> values;
+	
+	std::vector<float> PAFs;
+	
+	/* first value and first PAF of every frame, plus the end */
+	std::vector<size_t> valueStarts;
+	
+	std::vector<size_t> PAFStarts;
+	
+	explicit T4DAViewData() = default;
+};
+
+static bool parseDetections(TextScanner& scanner, const Session& session, int frameNum, T4DAViewData& view) {
+	int typeNum = session.typeNum;
+	view.jointNums.resize(static_cast<size_t>(frameNum) * typeNum);
+	view.valueStarts.assign(1, 0);
+	view.PAFStarts.assign(1, 0);
+	
+	for (int frame = 0; frame < frameNum; ++frame) {
+		int* jointNums = view.jointNums.data() + static_cast<size_t>(frame) * typeNum;
+		for (int type = 0; type < typeNum; ++type) {
+			if (!scanner.nextInt(jointNums[type]) || jointNums[type] < 0) return false;
+			for (int i = 0; i < jointNums[type] * 3; ++i) {
+				float value = 0;
+				if (!scanner.nextFloat(value)) return false;
+				view.values.emplace_back(value);
+			}
+		}
+		
+		for (int bone = 0; bone < session.boneNum; ++bone) {
+			int PAFNum = jointNums[session.boneA[bone]] * jointNums[session.boneB[bone]];
+			for (int i = 0; i < PAFNum; ++i) {
+				float PAF = 0;
+				if (!scanner.nextFloat(PAF)) return false;
+				view.PAFs.emplace_back(PAF);
+			}
+		}
+		
+		view.valueStarts.emplace_back(view.values.size());
+		view.PAFStarts.emplace_back(view.PAFs.size());
+	}
+	
+	/* the PAF transform is a separate pass over the contiguous scores, apart from the parsing */
+	for (float& PAF : view.PAFs) {
+		PAF = powf(PAF, 0.2f);
+	}
+	return true;
+}
+
+/* calibration, skeleton and mapped camera files of a dataset, with the hashes its caches are keyed by */
+class T4DASource {
+public:
+	std::shared_ptr<Session> session;
+	
+	std::vector<MappedFile> files;
+	
+	std::vector<TextScanner> scanners;
+	
+	int frameNum = 0;
+	
+	unsigned long long datasetHash = 0;
+	
+	unsigned long long calibrationHash = 0;
+	
+	explicit T4DASource() = default;
+};
+
+/* FNV-1a, chained through hash */
+static unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ULL) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Binary sidecar in the dataset folder holding every frame once its
+ * directions, transformed PAFs and epipolar distances are computed. A frame
+ * record is its joint numbers followed by MultiView::serialize.
+ */
+constexpr char AFFINITY_CACHE_MAGIC[4] = {'M', 'A', 'F', 'C'};
+constexpr unsigned AFFINITY_CACHE_VERSION = 1;
+
+struct AffinityCacheHeader {
+	char magic[4];
+	unsigned version;
+	unsigned long long datasetHash;
+	unsigned long long calibrationHash;
+	int metric;
+	int viewNum;
+	int typeNum;
+	int boneNum;
+	int frameNum;
+};
+
+static bool loadAffinityCache(const std::string& path, const T4DASource& source, EpipolarMetric metric, MultiViews& multiviews) {
+	MappedFile cache(path);
+	if (!cache.isOpen() || cache.size() < sizeof(AffinityCacheHeader)) return false;
+	
+	const Session& session = *source.session;
+	AffinityCacheHeader header;
+	memcpy(&header, cache.data(), sizeof(AffinityCacheHeader));
+	if (memcmp(header.magic, AFFINITY_CACHE_MAGIC, 4) != 0) return false;
+	if (header.version != AFFINITY_CACHE_VERSION) return false;
+	if (header.datasetHash != source.datasetHash || header.calibrationHash != source.calibrationHash) return false;
+	if (header.metric != static_cast<int>(metric)) return false;
+	if (header.viewNum != session.viewNum || header.typeNum != session.typeNum || header.boneNum != session.boneNum) return false;
+	if (header.frameNum != source.frameNum) return false;
+	
+	/* offsets of the frame records, plus the end of the file */
+	size_t frameNum = source.frameNum;
+	size_t tableSize = (frameNum + 1) * sizeof(unsigned long long);
+	if (cache.size() < sizeof(AffinityCacheHeader) + tableSize) return false;
+	std::vector<unsigned long long> recordStarts(frameNum + 1);
+	memcpy(recordStarts.data(), cache.data() + sizeof(AffinityCacheHeader), tableSize);
+	if (recordStarts.front() != sizeof(AffinityCacheHeader) + tableSize || recordStarts.back() != cache.size()) return false;
+	
+	size_t jointNumSize = session.viewNum * session.typeNum * sizeof(int);
+	for (size_t frame = 0; frame < frameNum; ++frame) {
+		if (recordStarts[frame + 1] < recordStarts[frame] + jointNumSize) return false;
+	}
+	
+	multiviews.resize(frameNum);
+	std::vector<unsigned char> isLoaded(frameNum, 0);
+	Parallel::forEach(0, static_cast<int>(frameNum), [&](int frame, int) -> void {
+		const char* record = cache.data() + recordStarts[frame];
+		size_t recordSize = recordStarts[frame + 1] - recordStarts[frame];
+		std::vector<int> jointNums(session.viewNum * session.typeNum);
+		memcpy(jointNums.data(), record, jointNumSize);
+		
+		/* every joint takes more than a byte, so a larger count can only come from a corrupt record */
+		for (int jointNum : jointNums) {
+			if (jointNum < 0 || static_cast<size_t>(jointNum) > recordSize) return;
+		}
+		
+		MultiView multiview(source.session, jointNums);
+		if (!multiview.deserialize(record + jointNumSize, recordSize - jointNumSize, metric)) return;
+		multiviews[frame] = std::move(multiview);
+		isLoaded[frame] = 1;
+	});
+	
+	for (unsigned char loaded : isLoaded) {
+		if (!loaded) return false;
+	}
+	return true;
+}
+
+static void saveAffinityCache(const std::string& path, const T4DASource& source, EpipolarMetric metric, const MultiViews& multiviews) {
+	const Session& session = *source.session;
+	AffinityCacheHeader header = {};
+	memcpy(header.magic, AFFINITY_CACHE_MAGIC, 4);
+	header.version = AFFINITY_CACHE_VERSION;
+	header.datasetHash = source.datasetHash;
+	header.calibrationHash = source.calibrationHash;
+	header.metric = static_cast<int>(metric);
+	header.viewNum = session.viewNum;
+	header.typeNum = session.typeNum;
+	header.boneNum = session.boneNum;
+	header.frameNum = static_cast<int>(multiviews.size());
+	
+	size_t frameNum = multiviews.size();
+	size_t jointNumSize = session.viewNum * session.typeNum * sizeof(int);
+	std::vector<unsigned long long> recordStarts(frameNum + 1);
+	recordStarts[0] = sizeof(AffinityCacheHeader) + recordStarts.size() * sizeof(unsigned long long);
+	for (size_t frame = 0; frame < frameNum; ++frame) {
+		recordStarts[frame + 1] = recordStarts[frame] + jointNumSize + multiviews[frame].getSerializedSize();
+	}
+	
+	/* write to a temporary file first so a partial cache is never picked up */
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream stream(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (stream.fail()) return;
+	
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(AffinityCacheHeader));
+	stream.write(reinterpret_cast<const char*>(recordStarts.data()), recordStarts.size() * sizeof(unsigned long long));
+	
+	std::vector<int> jointNums(session.viewNum * session.typeNum);
+	std::vector<char> buffer;
+	for (auto& multiview : multiviews) {
+		for (int view = 0; view < session.viewNum; ++view) {
+			for (int type = 0; type < session.typeNum; ++type) {
+				jointNums[view * session.typeNum + type] = multiview.getJointNum(view, type);
+			}
+		}
+		buffer.resize(multiview.getSerializedSize());
+		multiview.serialize(buffer.data());
+		stream.write(reinterpret_cast<const char*>(jointNums.data()), jointNumSize);
+		stream.write(buffer.data(), buffer.size());
+	}
+	stream.close();
 	
 	if (stream.fail()) {
+		std::remove(temporaryPath.c_str());
+		return;
+	}
+	std::rename(temporaryPath.c_str(), path.c_str());
+}
+
+static bool openSource(const std::string& path, T4DASource& source) {
+	MappedFile calibration(path + "/calibration.json");
+	
+	if (!calibration.isOpen()) {
 		std::cerr << "T4DALoader Error: Failed to load dataset\n";
-		return MultiViews();
+		return false;
 	}
 	
-	nlohmann::json camerasJson;
-	stream >> camerasJson;
+	source.calibrationHash = hashBytes(calibration.data(), calibration.size());
+	nlohmann::json camerasJson = nlohmann::json::parse(calibration.data(), calibration.data() + calibration.size());
 	
-	MultiView multiview;
+	source.session = std::make_shared<Session>();
+	auto& session = source.session;
 	
 	for (auto& [name, cameraJson] : camerasJson.items()) {
-		multiview.views.emplace_back(View());
-		multiview.views.back().camera = std::make_shared<Camera>();
-		auto& camera = multiview.views.back().camera;
+		session->cameras.emplace_back(std::make_shared<Camera>());
+		auto& camera = session->cameras.back();
 		
 		camera->name = name;
 		
@@ -113,156 +325,207 @@ MultiViews T4DALoader::loadDataset(const std::string& path) {
 		camera->computeRtKi();
 	}
 	
-	stream.close();
-	
-	Ink::Vec2 screenSize = multiview.views[0].camera->screenSize;
-	int viewNum = static_cast<int>(multiview.views.size());
+	calibration.close();
 	
-	MultiViews multiviews;
+	int viewNum = static_cast<int>(session->cameras.size());
+	session->viewNum = viewNum;
+	session->computeGeometry();
 	
 	int skeletonType = 0;
 	int frameNum = 0;
-	int jointTypeNum = 0;
-	int boneNum = 0;
-	std::vector<int> boneA;
-	std::vector<int> boneB;
 	
+	/* the detections are identified by their size and modification time, as the ground truth cache does */
 	std::string detectionRoot = path + "/detection/";
-	std::string detectionPath = detectionRoot + multiview.views[0].camera->name + ".txt";
-	stream = std::ifstream(detectionPath, std::fstream::in);
+	unsigned long long datasetHash = hashBytes(nullptr, 0);
+	source.files = std::vector<MappedFile>(viewNum);
+	source.scanners.reserve(viewNum);
 	
-	if (stream.fail()) {
-		std::cerr << "T4DALoader Error: Failed to load detection data\n";
-		return MultiViews();
+	for (int viewI = 0; viewI < viewNum; ++viewI) {
+		const std::string& name = session->cameras[viewI]->name;
+		MappedFile& file = source.files[viewI];
+		if (!file.open(detectionRoot + name + ".txt")) {
+			std::cerr << "T4DALoader Error: Failed to load detection data\n";
+			return false;
+		}
+		
+		unsigned long long fileSize = file.size();
+		long long fileTime = file.getModifiedTime();
+		datasetHash = hashBytes(name.data(), name.size(), datasetHash);
+		datasetHash = hashBytes(&fileSize, sizeof(fileSize), datasetHash);
+		datasetHash = hashBytes(&fileTime, sizeof(fileTime), datasetHash);
+		
+		source.scanners.emplace_back(file.data(), file.data() + file.size());
+		int viewFrameNum = 0;
+		if (!source.scanners[viewI].nextInt(skeletonType) || !source.scanners[viewI].nextInt(viewFrameNum)) {
+			std::cerr << "T4DALoader Error: Failed to parse detection data\n";
+			return false;
+		}
+		frameNum = viewI == 0 ? viewFrameNum : std::min(frameNum, viewFrameNum);
 	}
-	
-	stream >> skeletonType >> frameNum;
-	stream.close();
+	source.frameNum = frameNum;
+	source.datasetHash = datasetHash;
 	
 	if (skeletonType == 4) {
-		jointTypeNum = 25;
-		boneNum = 26;
-		boneA = {
+		session->setSkeleton(25, {
 			1, 9, 10, 8, 8, 12, 13, 1 , 2 , 3 , 2 , 1 , 5 ,
 			6, 5, 1 , 0, 0, 15, 16, 14, 19, 14, 11, 22, 11,
-		};
-		boneB = {
+		}, {
 			8, 10, 11, 9 , 12, 13, 14, 2 , 3 , 4 , 17, 5 , 6 ,
 			7, 18, 0 , 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
-		};
+		});
 	} else {
 		std::cerr << "T4DALoader Error: Unknown skeleton type\n";
-		return MultiViews();
+		return false;
 	}
+	return true;
+}
+
+static MultiViews parseDataset(T4DASource& source) {
+	const auto& session = source.session;
+	Ink::Vec2 screenSize = session->cameras[0]->screenSize;
+	int viewNum = session->viewNum;
+	int frameNum = source.frameNum;
+	std::vector<TextScanner>& scanners = source.scanners;
 	
-	multiviews.resize(frameNum, multiview);
-	
-	int jointID = 0;
+	int jointTypeNum = session->typeNum;
+	int boneNum = session->boneNum;
 	
+	/* the camera files are independent, each is parsed on its own thread */
+	std::vector<T4DAViewData> views(viewNum);
+	std::vector<unsigned char> isParsed(viewNum, 0);
+	Parallel::forEach(0, viewNum, [&](int viewI, int) -> void {
+		isParsed[viewI] = parseDetections(scanners[viewI], *session, frameNum, views[viewI]);
+	});
 	for (int viewI = 0; viewI < viewNum; ++viewI) {
-		std::string detectionPath = detectionRoot + multiview.views[viewI].camera->name + ".txt";
-		stream = std::ifstream(detectionPath, std::fstream::in);
-		
-		if (stream.fail()) {
-			std::cerr << "T4DALoader Error: Failed to load detection data\n";
+		if (!isParsed[viewI]) {
+			std::cerr << "T4DALoader Error: Failed to parse detection data\n";
 			return MultiViews();
 		}
+	}
+	
+	/* every frame is allocated once with its final size */
+	MultiViews multiviews(frameNum);
+	Parallel::forEach(0, frameNum, [&](int frame, int) -> void {
+		std::vector<int> jointNums(viewNum * jointTypeNum);
+		for (int viewI = 0; viewI < viewNum; ++viewI) {
+			const int* viewJointNums = views[viewI].jointNums.data() + static_cast<size_t>(frame) * jointTypeNum;
+			std::copy(viewJointNums, viewJointNums + jointTypeNum, jointNums.begin() + viewI * jointTypeNum);
+		}
 		
-		stream >> skeletonType >> frameNum;
-		
-		for (int frame = 0; frame < frameNum; ++frame) {
-			auto& view = multiviews[frame].views[viewI];
-			view.joints.resize(jointTypeNum);
-			
-			for (auto& jointChoices : view.joints) {
-				int jointChoiceNum = 0;
-				stream >> jointChoiceNum;
-				jointChoices.resize(jointChoiceNum);
-				
-				for (int i = 0; i < 3; ++i) {
-					for (int j = 0; j < jointChoiceNum; ++j) {
-						float value = 0;
-						stream >> value;
-						if (i == 0) jointChoices[j].uv.x = value * (screenSize.x - 1.f);
-						if (i == 1) jointChoices[j].uv.y = value * (screenSize.y - 1.f);
-						if (i == 2) jointChoices[j].conf = value;
-					}
-				}
-				
+		MultiView multiview(session, jointNums);
+		for (int viewI = 0; viewI < viewNum; ++viewI) {
+			const float* value = views[viewI].values.data() + views[viewI].valueStarts[frame];
+			for (int type = 0; type < jointTypeNum; ++type) {
+				int jointChoiceNum = jointNums[viewI * jointTypeNum + type];
+				Ink::Vec2* uvs = multiview.getUVs(viewI, type);
+				float* confs = multiview.getConfs(viewI, type);
 				for (int j = 0; j < jointChoiceNum; ++j) {
-					jointChoices[j].ID = jointID++;
-					jointChoices[j].ray = view.camera->computeRay(jointChoices[j].uv);
+					uvs[j].x = value[j] * (screenSize.x - 1.f);
+					uvs[j].y = value[jointChoiceNum + j] * (screenSize.y - 1.f);
+					confs[j] = value[jointChoiceNum * 2 + j];
 				}
+				value += jointChoiceNum * 3;
 			}
 			
+			const float* PAF = views[viewI].PAFs.data() + views[viewI].PAFStarts[frame];
 			for (int boneI = 0; boneI < boneNum; ++boneI) {
-				for (auto& jointA : view.joints[boneA[boneI]]) {
-					for (auto& jointB : view.joints[boneB[boneI]]) {
-						float PAF = 0;
-						stream >> PAF;
-						view.setPAF(jointA, jointB, powf(PAF, 0.2f));
-					}
-				}
+				int PAFNum = multiview.getJointNum(viewI, session->boneA[boneI]) *
+							 multiview.getJointNum(viewI, session->boneB[boneI]);
+				std::copy(PAF, PAF + PAFNum, multiview.getPAFs(viewI, boneI));
+				PAF += PAFNum;
 			}
 		}
 		
-		stream.close();
-	}
+		multiview.computeDirections();
+		multiviews[frame] = std::move(multiview);
+	});
+	
+	return multiviews;
+}
+
+MultiViews T4DALoader::loadDataset(const std::string& path) {
+	T4DASource source;
+	if (!openSource(path, source)) return MultiViews();
+	return parseDataset(source);
+}
+
+MultiViews T4DALoader::loadAffinities(const std::string& path, EpipolarMetric metric) {
+	T4DASource source;
+	if (!openSource(path, source)) return MultiViews();
+	
+	MultiViews multiviews;
+	std::string cachePath = path + (metric == EpipolarMetric::PIXEL ? "/affinity.pixel.cache" : "/affinity.ray.cache");
+	if (loadAffinityCache(cachePath, source, metric, multiviews)) return multiviews;
+	
+	multiviews = parseDataset(source);
+	Parallel::forEach(0, static_cast<int>(multiviews.size()), [&](int frame, int) -> void {
+		multiviews[frame].computeEpipolarDistances(metric);
+	});
+	
+	if (!multiviews.empty()) saveAffinityCache(cachePath, source, metric, multiviews);
 	
 	return multiviews;
 }
 
 MultiPersonPoses T4DALoader::loadGroundTruth(const std::string& path) {
-	std::ifstream stream(path, std::fstream::in);
+	MappedFile file(path);
 	
-	if (stream.fail()) {
+	if (!file.isOpen()) {
 		std::cerr << "T4DALoader Error: Failed to load ground truth\n";
 		return MultiPersonPoses();
 	}
 	
+	TextScanner scanner(file.data(), file.data() + file.size());
+	
 	int typeNum = 0;
 	int frameNum = 0;
-	stream >> typeNum >> frameNum;
+	if (!scanner.nextInt(typeNum) || !scanner.nextInt(frameNum)) {
+		std::cerr << "T4DALoader Error: Failed to parse ground truth\n";
+		return MultiPersonPoses();
+	}
+	
+	if (typeNum > Pose::JOINT_NUM) {
+		std::cerr << "T4DALoader Error: Too many joint types in ground truth\n";
+		return MultiPersonPoses();
+	}
 	
 	MultiPersonPoses multiPersonPoses(frameNum);
 	
-	for (int frame = 0; frame < frameNum; ++frame) {
+	/* per person, the x, y and z rows are followed by the row of joint flags */
+	bool isParsed = true;
+	for (int frame = 0; frame < frameNum && isParsed; ++frame) {
 		int personNum = 0;
-		stream >> personNum;
+		isParsed = scanner.nextInt(personNum) && personNum >= 0;
+		if (!isParsed) break;
 		
 		multiPersonPoses[frame].resize(personNum);
 		
-		for (int personI = 0; personI < personNum; ++personI) {
+		for (int personI = 0; personI < personNum && isParsed; ++personI) {
 			auto& personPose = multiPersonPoses[frame][personI];
 			
-			stream >> personPose.ID;
-			personPose.hasJoint.resize(typeNum);
-			personPose.jointPos.resize(typeNum);
-			
-			for (int i = 0; i < 4; ++i) {
-				for (int type = 0; type < typeNum; ++type) {
-					switch (i) {
-						case 0:
-							stream >> personPose.jointPos[type].x;
-							break;
-						case 1:
-							stream >> personPose.jointPos[type].y;
-							break;
-						case 2:
-							stream >> personPose.jointPos[type].z;
-							break;
-						default:
-							float hasJointF = 0;
-							stream >> hasJointF;
-							personPose.hasJoint[type] = hasJointF != 0.;
-							break;
-					}
+			isParsed = scanner.nextInt(personPose.ID);
+			for (int axis = 0; axis < 3 && isParsed; ++axis) {
+				for (int type = 0; type < typeNum && isParsed; ++type) {
+					auto& jointPos = personPose.jointPos[type];
+					isParsed = scanner.nextFloat(axis == 0 ? jointPos.x : axis == 1 ? jointPos.y : jointPos.z);
+				}
+			}
+			for (int type = 0; type < typeNum && isParsed; ++type) {
+				float hasJointF = 0;
+				isParsed = scanner.nextFloat(hasJointF);
+				if (hasJointF != 0.) {
+					personPose.setJoint(type, personPose.jointPos[type]);
+				} else {
+					personPose.removeJoint(type);
 				}
 			}
 		}
 	}
 	
-	stream.close();
+	if (!isParsed) {
+		std::cerr << "T4DALoader Error: Failed to parse ground truth\n";
+		return MultiPersonPoses();
+	}
 	
 	return multiPersonPoses;
 }
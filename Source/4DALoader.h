@@ -28,5 +28,13 @@ class T4DALoader {
 public:
 	static MultiViews loadDataset(const std::string& path);
 	
+	/**
+	 * Frames with their epipolar distances computed, so they are ready for
+	 * association. They are kept in a cache next to the detections, keyed by
+	 * the detection files, the calibration and the metric, and later calls
+	 * map it instead of parsing and computing again.
+	 */
+	static MultiViews loadAffinities(const std::string& path, EpipolarMetric metric = EpipolarMetric::RAY);
+	
 	static MultiPersonPoses loadGroundTruth(const std::string& path);
 };
@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "BoneConstraints.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+BoneConstraints::BoneConstraints(int typeNum) {
+	resize(typeNum);
+}
+
+int BoneConstraints::getTypeNum() const {
+	return typeNum;
+}
+
+void BoneConstraints::resize(int typeNum) {
+	if (typeNum <= this->typeNum) return;
+	
+	std::vector<float> newMinLengths(typeNum * typeNum, 0.f);
+	std::vector<float> newMaxLengths(typeNum * typeNum, std::numeric_limits<float>::max());
+	for (int a = 0; a < this->typeNum; ++a) {
+		for (int b = 0; b < this->typeNum; ++b) {
+			newMinLengths[a * typeNum + b] = minLengths[a * this->typeNum + b];
+			newMaxLengths[a * typeNum + b] = maxLengths[a * this->typeNum + b];
+		}
+	}
+	minLengths = std::move(newMinLengths);
+	maxLengths = std::move(newMaxLengths);
+	this->typeNum = typeNum;
+}
+
+float BoneConstraints::getMinLength(int jointTypeA, int jointTypeB) const {
+	if (jointTypeA >= typeNum || jointTypeB >= typeNum) return 0.f;
+	return minLengths[jointTypeA * typeNum + jointTypeB];
+}
+
+float BoneConstraints::getMaxLength(int jointTypeA, int jointTypeB) const {
+	if (jointTypeA >= typeNum || jointTypeB >= typeNum) return std::numeric_limits<float>::max();
+	return maxLengths[jointTypeA * typeNum + jointTypeB];
+}
+
+void BoneConstraints::setMinLength(int jointTypeA, int jointTypeB, float length) {
+	resize(std::max(jointTypeA, jointTypeB) + 1);
+	minLengths[jointTypeA * typeNum + jointTypeB] = length;
+	minLengths[jointTypeB * typeNum + jointTypeA] = length;
+}
+
+void BoneConstraints::setMaxLength(int jointTypeA, int jointTypeB, float length) {
+	resize(std::max(jointTypeA, jointTypeB) + 1);
+	maxLengths[jointTypeA * typeNum + jointTypeB] = length;
+	maxLengths[jointTypeB * typeNum + jointTypeA] = length;
+}
+
+void BoneConstraints::widen(float margin) {
+	for (auto& length : minLengths) {
+		length = std::max(length - margin, 0.f);
+	}
+	for (auto& length : maxLengths) {
+		if (length != std::numeric_limits<float>::max()) length += margin;
+	}
+}
+
+BoneConstraints BoneConstraints::learn(const MultiPersonPoses& multiPersonPoses, const std::vector<int>& parents,
+									   float percentile, bool isMinLearned) {
+	int typeNum = static_cast<int>(parents.size());
+	BoneConstraints constraints(typeNum);
+	
+	/* one pass over the frames, each thread collects its own samples of every bone */
+	int threadNum = Parallel::getThreadNum();
+	std::vector<std::vector<std::vector<float> > > samples(threadNum, std::vector<std::vector<float> >(typeNum));
+	Parallel::forEach(0, static_cast<int>(multiPersonPoses.size()), [&](int frame, int thread) -> void {
+		auto& threadSamples = samples[thread];
+		for (auto& pose : multiPersonPoses[frame]) {
+			for (int type = 0; type < typeNum; ++type) {
+				int parent = parents[type];
+				if (parent < 0 || !pose.hasJoint(type) || !pose.hasJoint(parent)) continue;
+				threadSamples[type].emplace_back(pose.jointPos[type].distance(pose.jointPos[parent]));
+			}
+		}
+	});
+	
+	percentile = std::clamp(percentile, 0.f, 0.5f);
+	for (int type = 0; type < typeNum; ++type) {
+		std::vector<float> lengths;
+		for (auto& threadSamples : samples) {
+			lengths.insert(lengths.end(), threadSamples[type].begin(), threadSamples[type].end());
+		}
+		if (lengths.empty()) continue;
+		
+		int last = static_cast<int>(lengths.size()) - 1;
+		int low = static_cast<int>(std::floor(percentile * last));
+		int high = static_cast<int>(std::ceil((1.f - percentile) * last));
+		std::nth_element(lengths.begin(), lengths.begin() + low, lengths.end());
+		float minLength = lengths[low];
+		std::nth_element(lengths.begin(), lengths.begin() + high, lengths.end());
+		float maxLength = lengths[high];
+		
+		if (isMinLearned) constraints.setMinLength(type, parents[type], minLength);
+		constraints.setMaxLength(type, parents[type], maxLength);
+	}
+	
+	return constraints;
+}
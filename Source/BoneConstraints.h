@@ -0,0 +1,77 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Views.h"
+
+#include <limits>
+
+/**
+ * Minimum and maximum length of every bone, kept as dense typeNum x typeNum
+ * tables so a check is two loads and two compares. Both orders of a bone
+ * share the same limits, bones without limits accept any length.
+ */
+class BoneConstraints {
+public:
+	explicit BoneConstraints() = default;
+	
+	explicit BoneConstraints(int typeNum);
+	
+	int getTypeNum() const;
+	
+	/* grows the tables to typeNum types, existing limits are kept */
+	void resize(int typeNum);
+	
+	float getMinLength(int jointTypeA, int jointTypeB) const;
+	
+	float getMaxLength(int jointTypeA, int jointTypeB) const;
+	
+	void setMinLength(int jointTypeA, int jointTypeB, float length);
+	
+	void setMaxLength(int jointTypeA, int jointTypeB, float length);
+	
+	bool isValid(int jointTypeA, int jointTypeB, float length) const {
+		int index = jointTypeA * typeNum + jointTypeB;
+		return (length >= minLengths[index]) & (length <= maxLengths[index]);
+	}
+	
+	/* loosens every limited bone by margin in meters, minimums stop at 0 */
+	void widen(float margin);
+	
+	/**
+	 * Learns the limits of the bones (type, parents[type]) from ground truth
+	 * in the same joint layout. percentile in [0, 0.5] ignores that fraction of
+	 * the samples at each end, 0 keeps the observed extremes. Only maximum
+	 * lengths are learned unless isMinLearned is set. Bones never seen in the
+	 * ground truth stay unlimited.
+	 */
+	static BoneConstraints learn(const MultiPersonPoses& multiPersonPoses, const std::vector<int>& parents,
+								 float percentile = 0, bool isMinLearned = false);
+	
+private:
+	int typeNum = 0;
+	
+	std::vector<float> minLengths;
+	
+	std::vector<float> maxLengths;
+};
@@ -0,0 +1,136 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * Blocking queue with a fixed capacity, used between pipeline stages so a
+ * fast stage cannot run unboundedly ahead of a slow one.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t capacity);
+	
+	/* blocks while the queue is full, returns false once closed */
+	bool push(T&& value);
+	
+	bool tryPush(T&& value);
+	
+	/* blocks while the queue is empty, returns false once closed and drained */
+	bool pop(T& value);
+	
+	bool tryPop(T& value);
+	
+	/* wakes every waiter, pending values can still be popped */
+	void close();
+	
+	void reopen();
+	
+	size_t size() const;
+	
+private:
+	size_t capacity = 0;
+	
+	bool isClosed = false;
+	
+	std::deque<T> values;
+	
+	mutable std::mutex mutex;
+	
+	std::condition_variable notFull;
+	
+	std::condition_variable notEmpty;
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+template <typename T>
+bool BoundedQueue<T>::push(T&& value) {
+	std::unique_lock<std::mutex> lock(mutex);
+	notFull.wait(lock, [this]() -> bool { return isClosed || values.size() < capacity; });
+	if (isClosed) return false;
+	values.emplace_back(std::move(value));
+	lock.unlock();
+	notEmpty.notify_one();
+	return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::tryPush(T&& value) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (isClosed || values.size() >= capacity) return false;
+	values.emplace_back(std::move(value));
+	lock.unlock();
+	notEmpty.notify_one();
+	return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::pop(T& value) {
+	std::unique_lock<std::mutex> lock(mutex);
+	notEmpty.wait(lock, [this]() -> bool { return isClosed || !values.empty(); });
+	if (values.empty()) return false;
+	value = std::move(values.front());
+	values.pop_front();
+	lock.unlock();
+	notFull.notify_one();
+	return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::tryPop(T& value) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (values.empty()) return false;
+	value = std::move(values.front());
+	values.pop_front();
+	lock.unlock();
+	notFull.notify_one();
+	return true;
+}
+
+template <typename T>
+void BoundedQueue<T>::close() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isClosed = true;
+	}
+	notFull.notify_all();
+	notEmpty.notify_all();
+}
+
+template <typename T>
+void BoundedQueue<T>::reopen() {
+	std::lock_guard<std::mutex> lock(mutex);
+	isClosed = false;
+}
+
+template <typename T>
+size_t BoundedQueue<T>::size() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return values.size();
+}
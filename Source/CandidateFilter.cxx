@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "CandidateFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+void CandidateFilter::setMinConf(float conf) {
+	minConf = conf;
+}
+
+void CandidateFilter::setSuppressionRadius(float radius) {
+	suppressionRadius = radius;
+}
+
+void CandidateFilter::setMaxCandidateNum(int candidateNum) {
+	maxCandidateNum = candidateNum;
+}
+
+bool CandidateFilter::isEnabled() const {
+	return minConf > 0 || suppressionRadius > 0 || maxCandidateNum > 0;
+}
+
+int CandidateFilter::apply(MultiView& multiview) const {
+	if (!isEnabled()) return 0;
+	
+	int viewNum = multiview.getViewNum();
+	int typeNum = multiview.getTypeNum();
+	int droppedNum = 0;
+	std::vector<unsigned char> isKept(multiview.getTotalJointNum(), 1);
+	
+	/* suppression grid with a cell per radius, the kept candidates of a cell are a linked list */
+	std::vector<int> order;
+	std::vector<int> nextInCell;
+	std::unordered_map<long long, int> cells;
+	float radius2 = suppressionRadius * suppressionRadius;
+	
+	for (int type = 0; type < typeNum; ++type) {
+		for (int view = 0; view < viewNum; ++view) {
+			int jointNum = multiview.getJointNum(view, type);
+			if (jointNum == 0) continue;
+			int start = multiview.getJointIndex(view, type, 0);
+			const Ink::Vec2* uvs = multiview.getUVs(view, type);
+			const float* confs = multiview.getConfs(view, type);
+			unsigned char* kept = isKept.data() + start;
+			
+			/* the confidence floor is a branchless pass over the contiguous confidences */
+			for (int choice = 0; choice < jointNum; ++choice) {
+				kept[choice] = confs[choice] >= minConf;
+			}
+			
+			bool isLimited = maxCandidateNum > 0 && jointNum > maxCandidateNum;
+			if (suppressionRadius <= 0 && !isLimited) continue;
+			
+			order.clear();
+			for (int choice = 0; choice < jointNum; ++choice) {
+				if (kept[choice]) order.emplace_back(choice);
+			}
+			std::stable_sort(order.begin(), order.end(), [&](int a, int b) -> bool {
+				return confs[a] > confs[b];
+			});
+			
+			nextInCell.assign(jointNum, -1);
+			cells.clear();
+			int keptNum = 0;
+			for (int choice : order) {
+				if (maxCandidateNum > 0 && keptNum == maxCandidateNum) {
+					kept[choice] = 0;
+					continue;
+				}
+				if (suppressionRadius > 0) {
+					long long cellX = static_cast<long long>(std::floor(uvs[choice].x / suppressionRadius));
+					long long cellY = static_cast<long long>(std::floor(uvs[choice].y / suppressionRadius));
+					bool isSuppressed = false;
+					for (long long y = cellY - 1; y <= cellY + 1 && !isSuppressed; ++y) {
+						for (long long x = cellX - 1; x <= cellX + 1 && !isSuppressed; ++x) {
+							auto cell = cells.find((y << 32) ^ (x & 0xffffffffLL));
+							if (cell == cells.end()) continue;
+							for (int other = cell->second; other != -1; other = nextInCell[other]) {
+								Ink::Vec2 offset = uvs[choice] - uvs[other];
+								if (offset.dot(offset) < radius2) {
+									isSuppressed = true;
+									break;
+								}
+							}
+						}
+					}
+					if (isSuppressed) {
+						kept[choice] = 0;
+						continue;
+					}
+					auto result = cells.emplace((cellY << 32) ^ (cellX & 0xffffffffLL), -1);
+					nextInCell[choice] = result.first->second;
+					result.first->second = choice;
+				}
+				++keptNum;
+			}
+		}
+	}
+	
+	for (unsigned char kept : isKept) {
+		droppedNum += kept == 0;
+	}
+	if (droppedNum > 0) multiview = multiview.selectJoints(isKept);
+	return droppedNum;
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Views.h"
+
+/**
+ * Drops joint candidates before the affinities are computed: a confidence
+ * floor, 2D non-maximum suppression within each view and joint type, and a
+ * cap on the candidates kept per view and type. Every stage is off by
+ * default, so an unconfigured filter leaves frames untouched.
+ */
+class CandidateFilter {
+public:
+	explicit CandidateFilter() = default;
+	
+	void setMinConf(float conf);
+	
+	/* in pixels, candidates closer than this to a more confident one are suppressed */
+	void setSuppressionRadius(float radius);
+	
+	void setMaxCandidateNum(int candidateNum);
+	
+	bool isEnabled() const;
+	
+	/* returns the number of dropped candidates, the frame is only rebuilt when some are dropped */
+	int apply(MultiView& multiview) const;
+	
+private:
+	float minConf = 0;
+	
+	float suppressionRadius = 0;
+	
+	int maxCandidateNum = 0;
+};
@@ -0,0 +1,306 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Evaluation.h"
+
+#include "MathUtils.h"
+#include "Parallel.h"
+
+#include "fmt/format.h"
+
+constexpr float NO_MATCH_COST = 1e6f;
+
+ActorEvaluation::ActorEvaluation(int boneNum, int jointNum) {
+	boneCorrects.resize(boneNum);
+	boneTotals.resize(boneNum);
+	jointCounts.resize(jointNum);
+	jointErrors.resize(jointNum);
+}
+
+void ActorEvaluation::merge(const ActorEvaluation& evaluation) {
+	if (boneTotals.empty()) {
+		*this = evaluation;
+		return;
+	}
+	frameNum += evaluation.frameNum;
+	matchedNum += evaluation.matchedNum;
+	alignedNum += evaluation.alignedNum;
+	alignedError += evaluation.alignedError;
+	size_t boneNum = boneTotals.size();
+	for (int bone = 0; bone < boneNum; ++bone) {
+		boneCorrects[bone] += evaluation.boneCorrects[bone];
+		boneTotals[bone] += evaluation.boneTotals[bone];
+	}
+	size_t jointNum = jointCounts.size();
+	for (int joint = 0; joint < jointNum; ++joint) {
+		jointCounts[joint] += evaluation.jointCounts[joint];
+		jointErrors[joint] += evaluation.jointErrors[joint];
+	}
+}
+
+float ActorEvaluation::getPCP() const {
+	int corrects = 0;
+	int totals = 0;
+	size_t boneNum = boneTotals.size();
+	for (int bone = 0; bone < boneNum; ++bone) {
+		corrects += boneCorrects[bone];
+		totals += boneTotals[bone];
+	}
+	return static_cast<float>(corrects) / static_cast<float>(totals);
+}
+
+float ActorEvaluation::getPCP(int bone) const {
+	return static_cast<float>(boneCorrects[bone]) / static_cast<float>(boneTotals[bone]);
+}
+
+float ActorEvaluation::getMPJPE() const {
+	int counts = 0;
+	double errors = 0;
+	size_t jointNum = jointCounts.size();
+	for (int joint = 0; joint < jointNum; ++joint) {
+		counts += jointCounts[joint];
+		errors += jointErrors[joint];
+	}
+	return static_cast<float>(errors / counts);
+}
+
+float ActorEvaluation::getMPJPE(int joint) const {
+	return static_cast<float>(jointErrors[joint] / jointCounts[joint]);
+}
+
+float ActorEvaluation::getPAMPJPE() const {
+	return static_cast<float>(alignedError / alignedNum);
+}
+
+void Evaluation::merge(const Evaluation& evaluation) {
+	for (auto& [ID, actor] : evaluation.actors) {
+		actors[ID].merge(actor);
+	}
+}
+
+float Evaluation::getPCP() const {
+	float PCP = 0;
+	int actorNum = 0;
+	for (auto& [ID, actor] : actors) {
+		float actorPCP = actor.getPCP();
+		if (std::isnan(actorPCP)) continue;
+		PCP += actorPCP;
+		++actorNum;
+	}
+	return PCP / static_cast<float>(actorNum);
+}
+
+float Evaluation::getMPJPE() const {
+	ActorEvaluation total;
+	for (auto& [ID, actor] : actors) {
+		total.merge(actor);
+	}
+	return total.getMPJPE();
+}
+
+float Evaluation::getPAMPJPE() const {
+	int alignedNum = 0;
+	double alignedError = 0;
+	for (auto& [ID, actor] : actors) {
+		alignedNum += actor.alignedNum;
+		alignedError += actor.alignedError;
+	}
+	return static_cast<float>(alignedError / alignedNum);
+}
+
+std::string Evaluation::toString() const {
+	std::string string;
+	for (auto& [ID, actor] : actors) {
+		string += fmt::format("Actor {:<3} | Frames: {:<5} | Matched: {:<5} | PCP: {:.4f} | MPJPE: {:.4f} | PA-MPJPE: {:.4f}\n",
+							  ID, actor.frameNum, actor.matchedNum, actor.getPCP(), actor.getMPJPE(), actor.getPAMPJPE());
+		string += "  Bone PCP:";
+		size_t boneNum = actor.boneTotals.size();
+		for (int bone = 0; bone < boneNum; ++bone) {
+			string += fmt::format(" {}:{:.3f}", bone, actor.getPCP(bone));
+		}
+		string += "\n  Joint MPJPE:";
+		size_t jointNum = actor.jointCounts.size();
+		for (int joint = 0; joint < jointNum; ++joint) {
+			if (actor.jointCounts[joint] == 0) continue;
+			string += fmt::format(" {}:{:.4f}", joint, actor.getMPJPE(joint));
+		}
+		string += "\n";
+	}
+	string += fmt::format("Average | PCP: {:.4f} | MPJPE: {:.4f} | PA-MPJPE: {:.4f}\n",
+						  getPCP(), getMPJPE(), getPAMPJPE());
+	return string;
+}
+
+void Evaluator::initBody25() {
+	setBones({5, 2, 6, 3, 12, 9, 13, 10, 1, 1}, {6, 3, 7, 4, 13, 10, 14, 11, 0, 8});
+	setJoints({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14});
+	PCPThreshold = 0.5f;
+}
+
+int Evaluator::getBoneNum() const {
+	return static_cast<int>(boneA.size());
+}
+
+void Evaluator::setBones(const std::vector<int>& boneA, const std::vector<int>& boneB) {
+	this->boneA = boneA;
+	this->boneB = boneB;
+}
+
+void Evaluator::setJoints(const std::vector<int>& joints) {
+	this->joints = joints;
+}
+
+void Evaluator::setIgnoredIDs(const std::vector<int>& IDs) {
+	ignoredIDs = IDs;
+}
+
+void Evaluator::setPCPThreshold(float threshold) {
+	PCPThreshold = threshold;
+}
+
+bool Evaluator::isIgnored(const Pose& poseGT) const {
+	if (poseGT.isEmpty()) return true;
+	return std::find(ignoredIDs.begin(), ignoredIDs.end(), poseGT.ID) != ignoredIDs.end();
+}
+
+std::vector<int> Evaluator::match(const MultiPersonPose& multiPersonPoseGT,
+								  const MultiPersonPose& multiPersonPose) const {
+	int personNumGT = static_cast<int>(multiPersonPoseGT.size());
+	int personNum = static_cast<int>(multiPersonPose.size());
+	std::vector<int> matches(personNumGT, -1);
+	if (personNumGT == 0 || personNum == 0) return matches;
+	
+	/* mean distance of the commonly visible joints */
+	std::vector<float> costs(personNumGT * personNum, NO_MATCH_COST);
+	for (int personGT = 0; personGT < personNumGT; ++personGT) {
+		auto& poseGT = multiPersonPoseGT[personGT];
+		if (isIgnored(poseGT)) continue;
+		for (int person = 0; person < personNum; ++person) {
+			auto& pose = multiPersonPose[person];
+			if (pose.isEmpty()) continue;
+			float distance = 0;
+			int commonNum = 0;
+			for (int type : joints) {
+				if (!poseGT.hasJoint(type) || !pose.hasJoint(type)) continue;
+				distance += poseGT.jointPos[type].distance(pose.jointPos[type]);
+				++commonNum;
+			}
+			if (commonNum == 0) continue;
+			costs[personGT * personNum + person] = distance / static_cast<float>(commonNum);
+		}
+	}
+	
+	MathUtils::solveAssignment(costs.data(), personNumGT, personNum, matches.data());
+	
+	for (int personGT = 0; personGT < personNumGT; ++personGT) {
+		int person = matches[personGT];
+		if (person != -1 && costs[personGT * personNum + person] >= NO_MATCH_COST) {
+			matches[personGT] = -1;
+		}
+	}
+	return matches;
+}
+
+bool Evaluator::testBone(const Pose& poseGT, const Pose& pose, int bone) const {
+	int typeA = boneA[bone];
+	int typeB = boneB[bone];
+	if (!pose.hasJoint(typeA) || !pose.hasJoint(typeB)) return false;
+	auto& posGTA = poseGT.jointPos[typeA];
+	auto& posGTB = poseGT.jointPos[typeB];
+	float error = pose.jointPos[typeA].distance(posGTA) + pose.jointPos[typeB].distance(posGTB);
+	return error * 0.5f < PCPThreshold * posGTA.distance(posGTB);
+}
+
+Evaluation Evaluator::evaluate(const MultiPersonPose& multiPersonPoseGT,
+							   const MultiPersonPose& multiPersonPose) const {
+	Evaluation evaluation;
+	evaluate(multiPersonPoseGT, multiPersonPose, evaluation);
+	return evaluation;
+}
+
+Evaluation Evaluator::evaluate(const MultiPersonPoses& multiPersonPosesGT, const MultiPersonPoses& multiPersonPoses,
+							   int offsetGT) const {
+	/* an offset past the ground truth leaves no frames to compare */
+	long long frameNumGT = std::max<long long>(0, static_cast<long long>(multiPersonPosesGT.size()) - offsetGT);
+	int frameNum = static_cast<int>(std::min(static_cast<long long>(multiPersonPoses.size()), frameNumGT));
+	
+	std::vector<Evaluation> evaluations(Parallel::getThreadNum());
+	Parallel::forEach(0, frameNum, [&](int frame, int thread) -> void {
+		evaluate(multiPersonPosesGT[frame + offsetGT], multiPersonPoses[frame], evaluations[thread]);
+	});
+	
+	for (int thread = 1; thread < evaluations.size(); ++thread) {
+		evaluations[0].merge(evaluations[thread]);
+	}
+	return evaluations[0];
+}
+
+void Evaluator::evaluate(const MultiPersonPose& multiPersonPoseGT, const MultiPersonPose& multiPersonPose,
+						 Evaluation& evaluation) const {
+	int boneNum = getBoneNum();
+	int jointNum = joints.empty() ? 0 : *std::max_element(joints.begin(), joints.end()) + 1;
+	
+	std::vector<Ink::Vec3> source(joints.size());
+	std::vector<Ink::Vec3> target(joints.size());
+	std::vector<Ink::Vec3> aligned(joints.size());
+	
+	auto matches = match(multiPersonPoseGT, multiPersonPose);
+	
+	int personNumGT = static_cast<int>(multiPersonPoseGT.size());
+	for (int personGT = 0; personGT < personNumGT; ++personGT) {
+		auto& poseGT = multiPersonPoseGT[personGT];
+		if (isIgnored(poseGT)) continue;
+		
+		auto& actor = evaluation.actors[poseGT.ID];
+		if (actor.boneTotals.empty()) actor = ActorEvaluation(boneNum, jointNum);
+		++actor.frameNum;
+		
+		const Pose* pose = matches[personGT] == -1 ? nullptr : &multiPersonPose[matches[personGT]];
+		
+		/* PCP: a missed actor fails every bone */
+		for (int bone = 0; bone < boneNum; ++bone) {
+			if (!poseGT.hasJoint(boneA[bone]) || !poseGT.hasJoint(boneB[bone])) continue;
+			++actor.boneTotals[bone];
+			actor.boneCorrects[bone] += pose != nullptr && testBone(poseGT, *pose, bone);
+		}
+		
+		if (pose == nullptr) continue;
+		++actor.matchedNum;
+		
+		int commonNum = 0;
+		for (int type : joints) {
+			if (!poseGT.hasJoint(type) || !pose->hasJoint(type)) continue;
+			actor.jointErrors[type] += pose->jointPos[type].distance(poseGT.jointPos[type]);
+			++actor.jointCounts[type];
+			source[commonNum] = pose->jointPos[type];
+			target[commonNum] = poseGT.jointPos[type];
+			++commonNum;
+		}
+		
+		if (commonNum < 3) continue;
+		MathUtils::procrustesAlign(source.data(), target.data(), commonNum, aligned.data());
+		for (int i = 0; i < commonNum; ++i) {
+			actor.alignedError += aligned[i].distance(target[i]);
+		}
+		actor.alignedNum += commonNum;
+	}
+}
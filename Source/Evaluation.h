@@ -0,0 +1,121 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Views.h"
+
+#include <map>
+
+class ActorEvaluation {
+public:
+	int frameNum = 0;
+	
+	int matchedNum = 0;
+	
+	int alignedNum = 0;
+	
+	double alignedError = 0;
+	
+	std::vector<int> boneCorrects;
+	
+	std::vector<int> boneTotals;
+	
+	std::vector<int> jointCounts;
+	
+	std::vector<double> jointErrors;
+	
+	explicit ActorEvaluation() = default;
+	
+	explicit ActorEvaluation(int boneNum, int jointNum);
+	
+	void merge(const ActorEvaluation& evaluation);
+	
+	float getPCP() const;
+	
+	float getPCP(int bone) const;
+	
+	float getMPJPE() const;
+	
+	float getMPJPE(int joint) const;
+	
+	float getPAMPJPE() const;
+};
+
+class Evaluation {
+public:
+	std::map<int, ActorEvaluation> actors;
+	
+	explicit Evaluation() = default;
+	
+	void merge(const Evaluation& evaluation);
+	
+	float getPCP() const;
+	
+	float getMPJPE() const;
+	
+	float getPAMPJPE() const;
+	
+	std::string toString() const;
+};
+
+class Evaluator {
+public:
+	explicit Evaluator() = default;
+	
+	void initBody25();
+	
+	int getBoneNum() const;
+	
+	void setBones(const std::vector<int>& boneA, const std::vector<int>& boneB);
+	
+	void setJoints(const std::vector<int>& joints);
+	
+	void setIgnoredIDs(const std::vector<int>& IDs);
+	
+	void setPCPThreshold(float threshold);
+	
+	bool isIgnored(const Pose& poseGT) const;
+	
+	std::vector<int> match(const MultiPersonPose& multiPersonPoseGT, const MultiPersonPose& multiPersonPose) const;
+	
+	bool testBone(const Pose& poseGT, const Pose& pose, int bone) const;
+	
+	Evaluation evaluate(const MultiPersonPose& multiPersonPoseGT, const MultiPersonPose& multiPersonPose) const;
+	
+	Evaluation evaluate(const MultiPersonPoses& multiPersonPosesGT, const MultiPersonPoses& multiPersonPoses,
+						int offsetGT = 0) const;
+	
+private:
+	float PCPThreshold = 0.5f;
+	
+	std::vector<int> boneA;
+	
+	std::vector<int> boneB;
+	
+	std::vector<int> joints;
+	
+	std::vector<int> ignoredIDs;
+	
+	void evaluate(const MultiPersonPose& multiPersonPoseGT, const MultiPersonPose& multiPersonPose,
+				  Evaluation& evaluation) const;
+};
@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "FakePublisher.h"
+
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+FakePublisher::~FakePublisher() {
+	disconnect();
+}
+
+bool FakePublisher::connect(const std::string& socketPath) {
+	disconnect();
+	
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "FakePublisher Error: Socket path is too long\n";
+		return false;
+	}
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+	
+	socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (socket == -1 || ::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+		std::cerr << "FakePublisher Error: Failed to connect to " << socketPath << "\n";
+		disconnect();
+		return false;
+	}
+	return true;
+}
+
+void FakePublisher::disconnect() {
+	if (socket != -1) close(socket);
+	socket = -1;
+}
+
+bool FakePublisher::publish(const DetectionPacket& packet) {
+	if (socket == -1) return false;
+	
+	packet.serialize(buffer);
+	const char* data = buffer.data();
+	size_t size = buffer.size();
+	while (size > 0) {
+#ifdef MSG_NOSIGNAL
+		ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+#else
+		ssize_t sent = send(socket, data, size, 0);
+#endif
+		if (sent <= 0) return false;
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+size_t FakePublisher::replay(const MultiViews& multiviews, int view, float period, float dropRate, float maxDelay) {
+	std::mt19937 random(view + 1);
+	std::uniform_real_distribution<float> uniform(0, 1);
+	
+	auto start = std::chrono::steady_clock::now();
+	size_t sentNum = 0;
+	for (size_t frame = 0; frame < multiviews.size(); ++frame) {
+		float time = period * frame + maxDelay * uniform(random);
+		std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<float>(time)));
+		if (uniform(random) < dropRate) continue;
+		
+		DetectionPacket packet = DetectionPacket::fromMultiView(multiviews[frame], view);
+		packet.timestamp = static_cast<unsigned long long>(period * 1e6f * frame);
+		if (!publish(packet)) return sentNum;
+		++sentNum;
+	}
+	return sentNum;
+}
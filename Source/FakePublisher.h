@@ -0,0 +1,54 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "LiveIngest.h"
+
+/**
+ * Replays the detections of one camera to a DetectionServer, optionally
+ * dropping and delaying packets to exercise the frame assembler.
+ */
+class FakePublisher {
+public:
+	explicit FakePublisher() = default;
+	
+	~FakePublisher();
+	
+	FakePublisher(const FakePublisher&) = delete;
+	
+	FakePublisher& operator=(const FakePublisher&) = delete;
+	
+	bool connect(const std::string& socketPath);
+	
+	void disconnect();
+	
+	bool publish(const DetectionPacket& packet);
+	
+	/* sends every frame of a view, with frame timestamps spaced by period */
+	size_t replay(const MultiViews& multiviews, int view, float period, float dropRate = 0, float maxDelay = 0);
+	
+private:
+	int socket = -1;
+	
+	std::vector<char> buffer;
+};
@@ -0,0 +1,504 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "LiveIngest.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+constexpr unsigned DETECTION_MAGIC = 0x50444d4d;
+
+bool DetectionPacket::isValid(const Session& session) const {
+	if (view < 0 || view >= session.viewNum) return false;
+	if (jointNums.size() != session.typeNum) return false;
+	
+	size_t jointNum = 0;
+	for (int number : jointNums) {
+		if (number < 0 || number > MAX_CANDIDATE_NUM) return false;
+		jointNum += number;
+	}
+	if (uvs.size() != jointNum || confs.size() != jointNum) return false;
+	
+	size_t PAFNum = 0;
+	for (int bone = 0; bone < session.boneNum; ++bone) {
+		PAFNum += jointNums[session.boneA[bone]] * jointNums[session.boneB[bone]];
+	}
+	return PAFs.size() == PAFNum;
+}
+
+void DetectionPacket::serialize(std::vector<char>& buffer) const {
+	unsigned header[8] = {};
+	unsigned typeNum = static_cast<unsigned>(jointNums.size());
+	unsigned jointNum = static_cast<unsigned>(confs.size());
+	unsigned PAFNum = static_cast<unsigned>(PAFs.size());
+	size_t payloadSize = (typeNum + jointNum * 3 + PAFNum) * 4;
+	
+	header[0] = DETECTION_MAGIC;
+	header[1] = static_cast<unsigned>(payloadSize);
+	header[2] = static_cast<unsigned>(view);
+	header[3] = typeNum;
+	memcpy(header + 4, &timestamp, sizeof(unsigned long long));
+	header[6] = jointNum;
+	header[7] = PAFNum;
+	
+	buffer.resize(HEADER_SIZE + payloadSize);
+	char* cursor = buffer.data();
+	memcpy(cursor, header, HEADER_SIZE);
+	cursor += HEADER_SIZE;
+	memcpy(cursor, jointNums.data(), typeNum * 4);
+	cursor += typeNum * 4;
+	memcpy(cursor, uvs.data(), jointNum * 8);
+	cursor += jointNum * 8;
+	memcpy(cursor, confs.data(), jointNum * 4);
+	cursor += jointNum * 4;
+	memcpy(cursor, PAFs.data(), PAFNum * 4);
+}
+
+bool DetectionPacket::deserialize(const char* data, size_t size) {
+	if (size < HEADER_SIZE) return false;
+	
+	unsigned header[8];
+	memcpy(header, data, HEADER_SIZE);
+	if (header[0] != DETECTION_MAGIC) return false;
+	
+	unsigned typeNum = header[3];
+	unsigned jointNum = header[6];
+	unsigned PAFNum = header[7];
+	size_t payloadSize = (static_cast<size_t>(typeNum) + jointNum * 3ull + PAFNum) * 4;
+	if (header[1] != payloadSize || size != HEADER_SIZE + payloadSize) return false;
+	
+	view = static_cast<int>(header[2]);
+	memcpy(&timestamp, header + 4, sizeof(unsigned long long));
+	jointNums.resize(typeNum);
+	uvs.resize(jointNum);
+	confs.resize(jointNum);
+	PAFs.resize(PAFNum);
+	
+	const char* cursor = data + HEADER_SIZE;
+	memcpy(jointNums.data(), cursor, typeNum * 4);
+	cursor += typeNum * 4;
+	memcpy(uvs.data(), cursor, jointNum * 8);
+	cursor += jointNum * 8;
+	memcpy(confs.data(), cursor, jointNum * 4);
+	cursor += jointNum * 4;
+	memcpy(PAFs.data(), cursor, PAFNum * 4);
+	return true;
+}
+
+DetectionPacket DetectionPacket::fromMultiView(const MultiView& multiview, int view) {
+	const Session& session = *multiview.session;
+	
+	DetectionPacket packet;
+	packet.view = view;
+	packet.timestamp = multiview.timestamp;
+	packet.jointNums.resize(session.typeNum);
+	for (int type = 0; type < session.typeNum; ++type) {
+		int jointNum = multiview.getJointNum(view, type);
+		const Ink::Vec2* uvs = multiview.getUVs(view, type);
+		const float* confs = multiview.getConfs(view, type);
+		packet.jointNums[type] = jointNum;
+		packet.uvs.insert(packet.uvs.end(), uvs, uvs + jointNum);
+		packet.confs.insert(packet.confs.end(), confs, confs + jointNum);
+	}
+	for (int bone = 0; bone < session.boneNum; ++bone) {
+		int PAFNum = multiview.getJointNum(view, session.boneA[bone]) * multiview.getJointNum(view, session.boneB[bone]);
+		const float* PAFs = multiview.getPAFs(view, bone);
+		packet.PAFs.insert(packet.PAFs.end(), PAFs, PAFs + PAFNum);
+	}
+	return packet;
+}
+
+size_t DetectionPacket::getPayloadSize(const char* header) {
+	unsigned values[2];
+	memcpy(values, header, sizeof(values));
+	if (values[0] != DETECTION_MAGIC) return static_cast<size_t>(-1);
+	return values[1];
+}
+
+size_t DetectionPacket::getMaxPayloadSize(const Session& session) {
+	size_t candidateNum = MAX_CANDIDATE_NUM;
+	size_t jointNum = session.typeNum * candidateNum;
+	size_t PAFNum = session.boneNum * candidateNum * candidateNum;
+	return (session.typeNum + jointNum * 3 + PAFNum) * 4;
+}
+
+FrameAssembler::FrameAssembler(const std::shared_ptr<const Session>& session, size_t ringCapacity) :
+session(session) {
+	int viewNum = session->viewNum;
+	for (int view = 0; view < viewNum; ++view) {
+		rings.emplace_back(std::make_unique<SPSCRing<Pending> >(ringCapacity));
+		claims.emplace_back(std::make_unique<std::atomic<bool> >(false));
+	}
+	pendings.resize(viewNum);
+	jointNums.resize(viewNum * session->typeNum);
+}
+
+const Session& FrameAssembler::getSession() const {
+	return *session;
+}
+
+bool FrameAssembler::claimView(int view) {
+	if (view < 0 || view >= session->viewNum) return false;
+	bool expected = false;
+	return claims[view]->compare_exchange_strong(expected, true);
+}
+
+void FrameAssembler::releaseView(int view) {
+	if (view < 0 || view >= session->viewNum) return;
+	claims[view]->store(false);
+}
+
+bool FrameAssembler::push(DetectionPacket&& packet) {
+	if (!packet.isValid(*session)) {
+		++droppedNum;
+		return false;
+	}
+	
+	int view = packet.view;
+	Pending pending;
+	pending.packet = std::move(packet);
+	pending.arrival = std::chrono::steady_clock::now();
+	if (!rings[view]->push(std::move(pending))) {
+		++droppedNum;
+		return false;
+	}
+	return true;
+}
+
+bool FrameAssembler::poll(MultiView& multiview) {
+	int viewNum = session->viewNum;
+	
+	Pending pending;
+	for (int view = 0; view < viewNum; ++view) {
+		while (rings[view]->pop(pending)) {
+			pendings[view].emplace_back(std::move(pending));
+		}
+	}
+	
+	/* packets of frames that are already emitted can only be discarded */
+	for (auto& viewPendings : pendings) {
+		while (!viewPendings.empty() && hasEmitted &&
+			   viewPendings.front().packet.timestamp <= lastTimestamp + syncTolerance) {
+			viewPendings.pop_front();
+			++lateNum;
+		}
+	}
+	
+	bool hasPending = false;
+	unsigned long long timestamp = 0;
+	for (auto& viewPendings : pendings) {
+		if (viewPendings.empty()) continue;
+		unsigned long long frontTimestamp = viewPendings.front().packet.timestamp;
+		if (!hasPending || frontTimestamp < timestamp) timestamp = frontTimestamp;
+		hasPending = true;
+	}
+	if (!hasPending) return false;
+	
+	/*
+	 * A view is resolved when its oldest packet belongs to this frame, or is
+	 * newer so the camera has skipped it. Unresolved views are waited for
+	 * until the deadline, counted from the first packet of this frame.
+	 */
+	bool isResolved = true;
+	auto arrival = std::chrono::steady_clock::time_point::max();
+	for (auto& viewPendings : pendings) {
+		if (viewPendings.empty()) {
+			isResolved = false;
+			continue;
+		}
+		auto& front = viewPendings.front();
+		if (front.packet.timestamp <= timestamp + syncTolerance) {
+			arrival = std::min(arrival, front.arrival);
+		}
+	}
+	if (!isResolved && std::chrono::steady_clock::now() - arrival < deadline) return false;
+	
+	assemble(multiview, timestamp);
+	return true;
+}
+
+void FrameAssembler::setDeadline(float seconds) {
+	deadline = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(seconds));
+}
+
+void FrameAssembler::setSyncTolerance(unsigned long long tolerance) {
+	syncTolerance = tolerance;
+}
+
+size_t FrameAssembler::getFrameNum() const {
+	return frameNum;
+}
+
+size_t FrameAssembler::getIncompleteNum() const {
+	return incompleteNum;
+}
+
+size_t FrameAssembler::getDroppedNum() const {
+	return droppedNum;
+}
+
+size_t FrameAssembler::getLateNum() const {
+	return lateNum;
+}
+
+void FrameAssembler::assemble(MultiView& multiview, unsigned long long timestamp) {
+	int viewNum = session->viewNum;
+	int typeNum = session->typeNum;
+	int boneNum = session->boneNum;
+	
+	/* missing views take part in the frame with no joints */
+	std::vector<const DetectionPacket*> packets(viewNum, nullptr);
+	bool isComplete = true;
+	for (int view = 0; view < viewNum; ++view) {
+		auto& viewPendings = pendings[view];
+		if (!viewPendings.empty() && viewPendings.front().packet.timestamp <= timestamp + syncTolerance) {
+			packets[view] = &viewPendings.front().packet;
+		} else {
+			isComplete = false;
+		}
+		for (int type = 0; type < typeNum; ++type) {
+			jointNums[view * typeNum + type] = packets[view] ? packets[view]->jointNums[type] : 0;
+		}
+	}
+	
+	multiview = MultiView(session, jointNums);
+	multiview.timestamp = timestamp;
+	
+	for (int view = 0; view < viewNum; ++view) {
+		const DetectionPacket* packet = packets[view];
+		if (!packet) continue;
+		
+		const Ink::Vec2* uv = packet->uvs.data();
+		const float* conf = packet->confs.data();
+		for (int type = 0; type < typeNum; ++type) {
+			int jointNum = packet->jointNums[type];
+			std::copy(uv, uv + jointNum, multiview.getUVs(view, type));
+			std::copy(conf, conf + jointNum, multiview.getConfs(view, type));
+			uv += jointNum;
+			conf += jointNum;
+		}
+		
+		const float* PAF = packet->PAFs.data();
+		for (int bone = 0; bone < boneNum; ++bone) {
+			int PAFNum = packet->jointNums[session->boneA[bone]] * packet->jointNums[session->boneB[bone]];
+			std::copy(PAF, PAF + PAFNum, multiview.getPAFs(view, bone));
+			PAF += PAFNum;
+		}
+		
+		pendings[view].pop_front();
+	}
+	
+	multiview.computeDirections();
+	
+	hasEmitted = true;
+	lastTimestamp = timestamp;
+	++frameNum;
+	if (!isComplete) ++incompleteNum;
+}
+
+DetectionServer::~DetectionServer() {
+	stop();
+}
+
+bool DetectionServer::start(const std::string& socketPath, FrameAssembler& assembler) {
+	stop();
+	
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "DetectionServer Error: Socket path is too long\n";
+		return false;
+	}
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+	
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenSocket == -1) {
+		std::cerr << "DetectionServer Error: Failed to create socket\n";
+		return false;
+	}
+	
+	unlink(socketPath.c_str());
+	if (bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+		listen(listenSocket, 16) == -1) {
+		std::cerr << "DetectionServer Error: Failed to listen on " << socketPath << "\n";
+		close(listenSocket);
+		listenSocket = -1;
+		return false;
+	}
+	
+	this->socketPath = socketPath;
+	running = true;
+	acceptThread = std::thread(&DetectionServer::accept, this, std::ref(assembler));
+	return true;
+}
+
+void DetectionServer::stop() {
+	running = false;
+	if (acceptThread.joinable()) acceptThread.join();
+	for (auto& connection : connections) {
+		connection.thread.join();
+	}
+	connections.clear();
+	if (listenSocket != -1) {
+		close(listenSocket);
+		unlink(socketPath.c_str());
+		listenSocket = -1;
+	}
+}
+
+void DetectionServer::accept(FrameAssembler& assembler) {
+	pollfd descriptor = {listenSocket, POLLIN, 0};
+	while (running) {
+		if (::poll(&descriptor, 1, 100) <= 0) continue;
+		int socket = ::accept(listenSocket, nullptr, nullptr);
+		if (socket == -1) continue;
+		
+		/* reconnecting publishers would otherwise grow the list without bound */
+		connections.remove_if([](Connection& connection) -> bool {
+			if (!connection.isFinished) return false;
+			connection.thread.join();
+			return true;
+		});
+		auto& connection = connections.emplace_back();
+		connection.thread = std::thread(&DetectionServer::receive, this, socket, std::ref(assembler),
+										std::ref(connection));
+	}
+}
+
+static bool receiveFully(int socket, char* data, size_t size, const std::atomic<bool>& running) {
+	pollfd descriptor = {socket, POLLIN, 0};
+	while (size > 0) {
+		if (!running) return false;
+		if (poll(&descriptor, 1, 100) <= 0) continue;
+		ssize_t received = recv(socket, data, size, 0);
+		if (received <= 0) return false;
+		data += received;
+		size -= received;
+	}
+	return true;
+}
+
+void DetectionServer::receive(int socket, FrameAssembler& assembler, Connection& connection) {
+	/* the first packet binds the connection to its view */
+	int view = -1;
+	std::vector<char> buffer(DetectionPacket::HEADER_SIZE);
+	size_t maxPayloadSize = DetectionPacket::getMaxPayloadSize(assembler.getSession());
+	DetectionPacket packet;
+	
+	while (running) {
+		buffer.resize(DetectionPacket::HEADER_SIZE);
+		if (!receiveFully(socket, buffer.data(), DetectionPacket::HEADER_SIZE, running)) break;
+		
+		size_t payloadSize = DetectionPacket::getPayloadSize(buffer.data());
+		if (payloadSize == static_cast<size_t>(-1)) {
+			std::cerr << "DetectionServer Error: Invalid packet\n";
+			break;
+		}
+		if (payloadSize > maxPayloadSize) {
+			std::cerr << "DetectionServer Error: Packet too large\n";
+			break;
+		}
+		buffer.resize(DetectionPacket::HEADER_SIZE + payloadSize);
+		if (!receiveFully(socket, buffer.data() + DetectionPacket::HEADER_SIZE, payloadSize, running)) break;
+		if (!packet.deserialize(buffer.data(), buffer.size())) {
+			std::cerr << "DetectionServer Error: Invalid packet\n";
+			break;
+		}
+		
+		if (view == -1) {
+			if (!assembler.claimView(packet.view)) {
+				std::cerr << "DetectionServer Error: View " << packet.view << " is already connected\n";
+				break;
+			}
+			view = packet.view;
+		}
+		if (packet.view != view) {
+			std::cerr << "DetectionServer Error: Packet view does not match the connection\n";
+			break;
+		}
+		assembler.push(std::move(packet));
+	}
+	
+	if (view != -1) assembler.releaseView(view);
+	close(socket);
+	connection.isFinished = true;
+}
+
+LiveIngest::LiveIngest(const std::shared_ptr<const Session>& session, size_t ringCapacity) :
+assembler(session, ringCapacity) {}
+
+LiveIngest::~LiveIngest() {
+	stop();
+}
+
+FrameAssembler& LiveIngest::getAssembler() {
+	return assembler;
+}
+
+void LiveIngest::setCandidateFilter(const CandidateFilter& candidateFilter) {
+	this->candidateFilter = candidateFilter;
+}
+
+size_t LiveIngest::getDroppedCandidateNum() const {
+	return droppedCandidateNum;
+}
+
+void LiveIngest::setEpipolarMetric(EpipolarMetric epipolarMetric) {
+	this->epipolarMetric = epipolarMetric;
+}
+
+void LiveIngest::setPAFCompression(float threshold, bool isHalf) {
+	PAFThreshold = threshold;
+	isHalfPAF = isHalf;
+}
+
+bool LiveIngest::start(const std::string& socketPath, QuickPose& quickpose, const PoseCallback& callback) {
+	stop();
+	if (!server.start(socketPath, assembler)) return false;
+	
+	running = true;
+	worker = std::thread([this, &quickpose, callback]() -> void {
+		MultiView multiview;
+		while (running) {
+			if (!assembler.poll(multiview)) {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+				continue;
+			}
+			droppedCandidateNum += candidateFilter.apply(multiview);
+			if (PAFThreshold > 0) multiview.compressPAFs(PAFThreshold, isHalfPAF);
+			multiview.computeEpipolarDistances(epipolarMetric);
+			callback(multiview, quickpose.compute(multiview));
+		}
+	});
+	return true;
+}
+
+void LiveIngest::stop() {
+	running = false;
+	if (worker.joinable()) worker.join();
+	server.stop();
+}
@@ -0,0 +1,218 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Views.h"
+#include "QuickPose.h"
+#include "CandidateFilter.h"
+#include "SPSCRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <list>
+#include <thread>
+
+/**
+ * Detections of one camera at one capture time. UVs are in pixels, joints
+ * are stored type by type and PAFs bone by bone in the session order.
+ */
+class DetectionPacket {
+public:
+	int view = 0;
+	unsigned long long timestamp = 0;
+	std::vector<int> jointNums;
+	std::vector<Ink::Vec2> uvs;
+	std::vector<float> confs;
+	std::vector<float> PAFs;
+	
+	explicit DetectionPacket() = default;
+	
+	bool isValid(const Session& session) const;
+	
+	void serialize(std::vector<char>& buffer) const;
+	
+	bool deserialize(const char* data, size_t size);
+	
+	static DetectionPacket fromMultiView(const MultiView& multiview, int view);
+	
+	/* the fixed part of a serialized packet, which holds the payload size */
+	static constexpr size_t HEADER_SIZE = 32;
+	
+	static size_t getPayloadSize(const char* header);
+	
+	/* candidates per joint type a packet may carry, bounds what a connection can make us allocate */
+	static constexpr int MAX_CANDIDATE_NUM = 64;
+	
+	static size_t getMaxPayloadSize(const Session& session);
+};
+
+class FrameAssembler {
+public:
+	explicit FrameAssembler(const std::shared_ptr<const Session>& session, size_t ringCapacity = 64);
+	
+	const Session& getSession() const;
+	
+	/* a view accepts packets from a single producer thread at a time */
+	bool claimView(int view);
+	
+	void releaseView(int view);
+	
+	/* producer side, returns false when the packet is dropped */
+	bool push(DetectionPacket&& packet);
+	
+	/* consumer side, returns true when a frame is assembled */
+	bool poll(MultiView& multiview);
+	
+	void setDeadline(float seconds);
+	
+	/* packets within the tolerance of a frame belong to it, keep it below half a frame period */
+	void setSyncTolerance(unsigned long long tolerance);
+	
+	size_t getFrameNum() const;
+	
+	size_t getIncompleteNum() const;
+	
+	size_t getDroppedNum() const;
+	
+	size_t getLateNum() const;
+	
+private:
+	class Pending {
+	public:
+		DetectionPacket packet;
+		std::chrono::steady_clock::time_point arrival;
+	};
+	
+	std::shared_ptr<const Session> session;
+	
+	std::chrono::steady_clock::duration deadline = std::chrono::milliseconds(50);
+	
+	unsigned long long syncTolerance = 1000;
+	
+	bool hasEmitted = false;
+	
+	unsigned long long lastTimestamp = 0;
+	
+	std::vector<std::unique_ptr<SPSCRing<Pending> > > rings;
+	
+	std::vector<std::unique_ptr<std::atomic<bool> > > claims;
+	
+	std::vector<std::deque<Pending> > pendings;
+	
+	std::vector<int> jointNums;
+	
+	/* counters are read by other threads while the consumer is running */
+	std::atomic<size_t> frameNum = 0;
+	
+	std::atomic<size_t> incompleteNum = 0;
+	
+	std::atomic<size_t> droppedNum = 0;
+	
+	std::atomic<size_t> lateNum = 0;
+	
+	void assemble(MultiView& multiview, unsigned long long timestamp);
+};
+
+class DetectionServer {
+public:
+	explicit DetectionServer() = default;
+	
+	~DetectionServer();
+	
+	bool start(const std::string& socketPath, FrameAssembler& assembler);
+	
+	void stop();
+	
+private:
+	std::string socketPath;
+	
+	int listenSocket = -1;
+	
+	std::atomic<bool> running = false;
+	
+	class Connection {
+	public:
+		std::thread thread;
+		
+		std::atomic<bool> isFinished = false;
+	};
+	
+	std::thread acceptThread;
+	
+	/* owned by the accept thread, finished connections are joined on the next accept */
+	std::list<Connection> connections;
+	
+	void accept(FrameAssembler& assembler);
+	
+	void receive(int socket, FrameAssembler& assembler, Connection& connection);
+};
+
+/**
+ * Accepts detection packets on a Unix domain socket, assembles them into
+ * frames and runs QuickPose on every completed frame.
+ */
+class LiveIngest {
+public:
+	using PoseCallback = std::function<void(const MultiView&, MultiPersonPose&&)>;
+	
+	explicit LiveIngest(const std::shared_ptr<const Session>& session, size_t ringCapacity = 64);
+	
+	~LiveIngest();
+	
+	FrameAssembler& getAssembler();
+	
+	/* set before start, frames are filtered on the worker thread */
+	void setCandidateFilter(const CandidateFilter& candidateFilter);
+	
+	size_t getDroppedCandidateNum() const;
+	
+	void setEpipolarMetric(EpipolarMetric epipolarMetric);
+	
+	/* frames keep only PAFs at or above threshold after filtering, 0 keeps them dense */
+	void setPAFCompression(float threshold, bool isHalf);
+	
+	bool start(const std::string& socketPath, QuickPose& quickpose, const PoseCallback& callback);
+	
+	void stop();
+	
+private:
+	FrameAssembler assembler;
+	
+	DetectionServer server;
+	
+	CandidateFilter candidateFilter;
+	
+	std::atomic<size_t> droppedCandidateNum = 0;
+	
+	EpipolarMetric epipolarMetric = EpipolarMetric::RAY;
+	
+	float PAFThreshold = 0;
+	
+	bool isHalfPAF = false;
+	
+	std::atomic<bool> running = false;
+	
+	std::thread worker;
+};
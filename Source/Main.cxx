@@ -4,6 +4,10 @@
 #include "OneRoom.h"
 #include "Visualizer2D.h"
 #include "MathUtils.h"
+#include "Evaluation.h"
+#include "SkeletonConverter.h"
+#include "Pipeline.h"
+#include "PoseStream.h"
 
 #include "fmt/format.h"
 
@@ -25,6 +29,7 @@ constexpr int VIEWPORT_WIDTH = WINDOW_WIDTH << HIGH_DPI;
 constexpr int VIEWPORT_HEIGHT = WINDOW_HEIGHT << HIGH_DPI;
 
 constexpr float MAX_EPIPOLAR_DISTANCE = 0.1f;
+constexpr float BONE_LENGTH_MARGIN = 0.1f;
 
 const Ink::Vec3 RED = {10.4, 1, 1};
 const Ink::Vec3 GREEN = {1, 3.8, 1};
@@ -33,156 +38,32 @@ const Ink::Vec3 WHITE = {2, 2, 2};
 QuickPose quickpose;
 MultiViews multiviews;
 
+Pipeline pipeline(quickpose);
+BoundedQueue<PipelineFrame> finishedFrames(8);
+PoseStreamPublisher poseStream;
+bool isPublishing = false;
+
+Evaluator evaluator;
+Evaluation evaluation;
+
 MultiPersonPose computedMultiPersonPose;
 MultiPersonPoses multiPersonPoses4DA;
 MultiPersonPoses multiPersonPosesGT;
 
-/* Incorrect conversion */
-void shelfToBody25(MultiPersonPoses& multiPersonPoses) {
-	constexpr int jointMapping[] = {
-		13, 12, 8, 7, 6, 9, 10, 11, 0, 2, 1, 0, 3, 4, 5,
-	};
-	for (auto& multiPersonPose : multiPersonPoses) {
-		for (auto& pose : multiPersonPose) {
-			if (pose.hasJoint.empty()) continue;
-			Pose newPose;
-			newPose.ID = pose.ID;
-			newPose.hasJoint.resize(25);
-			newPose.jointPos.resize(25);
-			for (int type = 0; type < 15; ++type) {
-				int mappingType = jointMapping[type];
-				if (pose.hasJoint[mappingType]) {
-					newPose.hasJoint[type] = true;
-					newPose.jointPos[type] = pose.jointPos[mappingType];
-				} else {
-					newPose.hasJoint[type] = false;
-				}
-			}
-			if (pose.hasJoint[2] && pose.hasJoint[3]) {
-				newPose.hasJoint[8] = true;
-				newPose.jointPos[8] = (pose.jointPos[2] + pose.jointPos[3]) * 0.5;
-			} else {
-				newPose.hasJoint[8] = false;
-			}
-			pose = newPose;
-		}
-	}
-}
-
-void correctShelfAtBody25(MultiPersonPose& multiPersonPose) {
-	for (auto& pose : multiPersonPose) {
-		Ink::Vec3 faceDir = (pose.jointPos[1] - pose.jointPos[8])
-			.cross(pose.jointPos[2] - pose.jointPos[5]).normalize();
-		Ink::Vec3 zDir = {0, 0, 1};
-		Ink::Vec3 shoulderCenter = (pose.jointPos[2] + pose.jointPos[5]) * 0.5f;
-		Ink::Vec3 headCenter = (pose.jointPos[17] + pose.jointPos[18]) * 0.5f;
-		
-		if (pose.hasJoint[17] ^ pose.hasJoint[18]) {
-			Ink::Vec3 ear;
-			if (pose.hasJoint[17]) ear = pose.jointPos[17];
-			if (pose.hasJoint[18]) ear = pose.jointPos[18];
-			Ink::Vec3 v1 = pose.jointPos[0] - shoulderCenter;
-			Ink::Vec3 v2 = {0, 0, 1};
-			Ink::Vec3 vn = v1.cross(v2).normalize();
-			headCenter = ear - (ear - shoulderCenter).dot(vn) * vn;
-		}
-		
-		if (pose.hasJoint[2] && pose.hasJoint[5]) {
-			pose.jointPos[1] = shoulderCenter + (headCenter - shoulderCenter) * 0.5f;
-			pose.jointPos[0] = pose.jointPos[1] + faceDir * 0.125f + zDir * 0.145f;
-		}
-		
-//		std::cout << (headCenter - shoulderCenter).normalize().dot({0, 0, 1}) << std::endl;
-		
-//		Ink::Vec3 coco0 = pose.jointPos[0];
-//		Ink::Vec3 neck = (pose.jointPos[5] + pose.jointPos[2]) / 2;
-//		Ink::Vec3 head_bottom = (neck + pose.jointPos[0]) / 2;
-//		Ink::Vec3 head_center = (pose.jointPos[17] + pose.jointPos[18]) / 2;
-//		Ink::Vec3 head_top = head_bottom + (head_center - head_bottom) * 2;
-//
-//		pose.jointPos[1] = (pose.jointPos[2] + pose.jointPos[5]) / 2;
-//		pose.jointPos[0] = pose.jointPos[1] + (coco0 - pose.jointPos[1]) * Ink::Vec3(0.78, 0.5, 1.5);
-//		pose.jointPos[1] = pose.jointPos[1] + (coco0 - pose.jointPos[1]) * Ink::Vec3(0.3, 0.4, 0.6);
-	}
-}
-
-void skel19ToBody25(MultiPersonPoses& multiPersonPoses) {
-	constexpr int jointMapping[] = {
-		4, 1, 5, 11, 15, 6, 12, 16, 0, 2, 7, 13, 3, 8, 14, -1, -1, 9, 10, 17, -1, -1, 18, -1, -1
-	};
-	for (auto& multiPersonPose : multiPersonPoses) {
-		for (auto& pose : multiPersonPose) {
-			if (pose.hasJoint.empty()) continue;
-			Pose newPose;
-			newPose.ID = pose.ID;
-			newPose.hasJoint.resize(25);
-			newPose.jointPos.resize(25);
-			for (int type = 0; type < 25; ++type) {
-				int mappingType = jointMapping[type];
-				if (mappingType != -1 && pose.hasJoint[mappingType]) {
-					newPose.hasJoint[type] = true;
-					newPose.jointPos[type] = pose.jointPos[mappingType];
-				} else {
-					newPose.hasJoint[type] = false;
-				}
-			}
-			pose = newPose;
-		}
-	}
-}
-
-void coco17ToBody25(MultiPersonPoses& multiPersonPoses) {
-	constexpr int jointMapping[] = {
-		0, -1, 6, 8, 10, 5, 7, 9, -1, 12, 14, 16, 11, 13, 15, 1, 2, 3, 4, -1, -1, -1, -1, -1, -1
-	};
-	for (auto& multiPersonPose : multiPersonPoses) {
-		for (auto& pose : multiPersonPose) {
-			if (pose.hasJoint.empty()) continue;
-			Pose newPose;
-			newPose.ID = pose.ID;
-			newPose.hasJoint.resize(25);
-			newPose.jointPos.resize(25);
-			for (int type = 0; type < 25; ++type) {
-				int mappingType = jointMapping[type];
-				if (mappingType != -1 && pose.hasJoint[mappingType]) {
-					newPose.hasJoint[type] = true;
-					newPose.jointPos[type] = pose.jointPos[mappingType];
-				} else {
-					newPose.hasJoint[type] = false;
-				}
-			}
-			if (newPose.hasJoint[2] && newPose.hasJoint[5]) {
-				newPose.hasJoint[1] = true;
-				newPose.jointPos[1] = (newPose.jointPos[2] + newPose.jointPos[5]) * 0.5;
-			}
-			if (newPose.hasJoint[9] && newPose.hasJoint[12]) {
-				newPose.hasJoint[8] = true;
-				newPose.jointPos[8] = (newPose.jointPos[9] + newPose.jointPos[12]) * 0.5;
-			}
-			pose = newPose;
-		}
-	}
-}
-
 Ink::Vec3 mapping(const Ink::Vec3& pos) {
 	return Ink::Vec3(pos.x, pos.z, -pos.y) + Ink::Vec3(1, 0.1, 0);
 }
 
 void test() {
-	MultiViews multiviews = T4DALoader::loadDataset("../Dataset/shelf");
+	MultiViews multiviews = T4DALoader::loadAffinities("../Dataset/shelf");
 	
-	auto multiview = multiviews[100];
-	multiview.computeEpipolar(MAX_EPIPOLAR_DISTANCE);
-	
-	Joint& joint1 = multiview.views[0].joints[1][1];
-	Joint& joint2 = multiview.views[0].joints[8][3];
-	Joint& joint3 = multiview.views[1].joints[8][0];
+	auto& multiview = multiviews[100];
 	
 	/* PAF test: should be 0.995882 */
-	std::cout << multiview.views[0].getPAF(joint1, joint2) << std::endl;
+	std::cout << multiview.getPAF(0, 1, 1, 8, 3) << std::endl;
 	
 	/* Epipolar test: should be 0.806705 */
-	std::cout << multiview.getEpipolar(joint2, joint3) << std::endl;
+	std::cout << 1.f - multiview.getEpipolarDistance(8, 0, 3, 1, 0) / MAX_EPIPOLAR_DISTANCE << std::endl;
 	
 	/* Ray Intersect test: should be 1.6 */
 	const Ink::Ray* rays[2];
@@ -194,9 +75,12 @@ void test() {
 
 void prepare() {
 	quickpose.initBody25();
+	quickpose.setMaxEpipolarDistance(MAX_EPIPOLAR_DISTANCE);
+	
+	evaluator.initBody25();
+	evaluator.setIgnoredIDs({4});
 	
-	multiviews = T4DALoader::loadDataset("../Dataset/shelf");
-	multiPersonPosesGT = T4DALoader::loadGroundTruth("../Dataset/shelf/gt.txt");
+	multiviews = T4DALoader::loadAffinities("../Dataset/shelf");
 	
 //	for (int i = 0; i < 5; ++i) {
 //		std::cout << multiviews[0].views[i].camera->R.to_string(6);
@@ -204,93 +88,28 @@ void prepare() {
 //		std::cout << multiviews[0].views[i].camera->K.to_string(6) << std::endl;
 //	}
 	
-//	float L01 = 0, L12 = 0, L23 = 0, L34 = 0, L15 = 0, L56 = 0, L67 = 0;
-//	float L18 = 0, L89 = 0, L910 = 0, L1011 = 0, L812 = 0, L1213 = 0, L1314 = 0;
-//	float L217 = 0, L518 = 0;
-//
-//	for (auto& multiPersonPose : multiPersonPosesGT) {
-//		for (auto& personPose : multiPersonPose) {
-//			L01 = fmax(L01, personPose.jointPos[4].distance(personPose.jointPos[1]));
-//			L12 = fmax(L12, personPose.jointPos[1].distance(personPose.jointPos[5]));
-//			L23 = fmax(L23, personPose.jointPos[5].distance(personPose.jointPos[11]));
-//			L34 = fmax(L34, personPose.jointPos[11].distance(personPose.jointPos[15]));
-//			L15 = fmax(L15, personPose.jointPos[1].distance(personPose.jointPos[6]));
-//			L56 = fmax(L56, personPose.jointPos[6].distance(personPose.jointPos[12]));
-//			L67 = fmax(L67, personPose.jointPos[12].distance(personPose.jointPos[16]));
-//			L18 = fmax(L18, personPose.jointPos[1].distance(personPose.jointPos[0]));
-//			L89 = fmax(L89, personPose.jointPos[0].distance(personPose.jointPos[2]));
-//			L910 = fmax(L910, personPose.jointPos[2].distance(personPose.jointPos[7]));
-//			L1011 = fmax(L1011, personPose.jointPos[7].distance(personPose.jointPos[13]));
-//			L812 = fmax(L812, personPose.jointPos[0].distance(personPose.jointPos[3]));
-//			L1213 = fmax(L1213, personPose.jointPos[3].distance(personPose.jointPos[8]));
-//			L1314 = fmax(L1314, personPose.jointPos[8].distance(personPose.jointPos[14]));
-//			L217 = fmax(L217, personPose.jointPos[5].distance(personPose.jointPos[9]));
-//			L518 = fmax(L518, personPose.jointPos[6].distance(personPose.jointPos[10]));
-//		}
-//	}
-//
-//	quickpose.setMaxBoneLength(0,  1,  L01   + 0.1f); std::cout << "L01: " << L01 << std::endl;
-//	quickpose.setMaxBoneLength(1,  2,  L12   + 0.1f); std::cout << "L12: " << L12 << std::endl;
-//	quickpose.setMaxBoneLength(2,  3,  L23   + 0.1f); std::cout << "L23: " << L23 << std::endl;
-//	quickpose.setMaxBoneLength(3,  4,  L34   + 0.1f); std::cout << "L34: " << L34 << std::endl;
-//	quickpose.setMaxBoneLength(1,  5,  L15   + 0.1f); std::cout << "L15: " << L15 << std::endl;
-//	quickpose.setMaxBoneLength(5,  6,  L56   + 0.1f); std::cout << "L56: " << L56 << std::endl;
-//	quickpose.setMaxBoneLength(6,  7,  L67   + 0.1f); std::cout << "L67: " << L67 << std::endl;
-//	quickpose.setMaxBoneLength(1,  8,  L18   + 0.1f); std::cout << "L18: " << L18 << std::endl;
-//	quickpose.setMaxBoneLength(8,  9,  L89   + 0.1f); std::cout << "L89: " << L89 << std::endl;
-//	quickpose.setMaxBoneLength(9,  10, L910  + 0.1f); std::cout << "L910: " << L910 << std::endl;
-//	quickpose.setMaxBoneLength(10, 11, L1011 + 0.1f); std::cout << "L1011: " << L1011 << std::endl;
-//	quickpose.setMaxBoneLength(8,  12, L812  + 0.1f); std::cout << "L812: " << L812 << std::endl;
-//	quickpose.setMaxBoneLength(12, 13, L1213 + 0.1f); std::cout << "L1213: " << L1213 << std::endl;
-//	quickpose.setMaxBoneLength(13, 14, L1314 + 0.1f); std::cout << "L1314: " << L1314 << std::endl;
-//	quickpose.setMaxBoneLength(2,  17, L217  + 0.1f); std::cout << "L217: " << L217 << std::endl;
-//	quickpose.setMaxBoneLength(5,  18, L518  + 0.1f); std::cout << "L518: " << L518 << std::endl;
-	
-	float L01 = 0, L12 = 0, L23 = 0, L34 = 0, L15 = 0, L56 = 0, L67 = 0;
-	float L18 = 0, L89 = 0, L910 = 0, L1011 = 0, L812 = 0, L1213 = 0, L1314 = 0;
-	
-	for (auto& multiPersonPose : multiPersonPosesGT) {
-		for (auto& personPose : multiPersonPose) {
-			L01 = fmax(L01, personPose.jointPos[13].distance(personPose.jointPos[12]));
-			L12 = fmax(L12, personPose.jointPos[12].distance(personPose.jointPos[8]));
-			L23 = fmax(L23, personPose.jointPos[8].distance(personPose.jointPos[7]));
-			L34 = fmax(L34, personPose.jointPos[7].distance(personPose.jointPos[6]));
-			L15 = fmax(L15, personPose.jointPos[12].distance(personPose.jointPos[9]));
-			L56 = fmax(L56, personPose.jointPos[9].distance(personPose.jointPos[10]));
-			L67 = fmax(L67, personPose.jointPos[10].distance(personPose.jointPos[11]));
-			L18 = fmax(L18, personPose.jointPos[12].distance(personPose.jointPos[14]));
-			L89 = fmax(L89, personPose.jointPos[14].distance(personPose.jointPos[2]));
-			L910 = fmax(L910, personPose.jointPos[2].distance(personPose.jointPos[1]));
-			L1011 = fmax(L1011, personPose.jointPos[1].distance(personPose.jointPos[0]));
-			L812 = fmax(L812, personPose.jointPos[14].distance(personPose.jointPos[3]));
-			L1213 = fmax(L1213, personPose.jointPos[3].distance(personPose.jointPos[4]));
-			L1314 = fmax(L1314, personPose.jointPos[4].distance(personPose.jointPos[5]));
-		}
-	}
-	
-	quickpose.setMaxBoneLength(0,  1,  L01   + 0.1f); std::cout << "L01: " << L01 << std::endl;
-	quickpose.setMaxBoneLength(1,  2,  L12   + 0.1f); std::cout << "L12: " << L12 << std::endl;
-	quickpose.setMaxBoneLength(2,  3,  L23   + 0.1f); std::cout << "L23: " << L23 << std::endl;
-	quickpose.setMaxBoneLength(3,  4,  L34   + 0.1f); std::cout << "L34: " << L34 << std::endl;
-	quickpose.setMaxBoneLength(1,  5,  L15   + 0.1f); std::cout << "L15: " << L15 << std::endl;
-	quickpose.setMaxBoneLength(5,  6,  L56   + 0.1f); std::cout << "L56: " << L56 << std::endl;
-	quickpose.setMaxBoneLength(6,  7,  L67   + 0.1f); std::cout << "L67: " << L67 << std::endl;
-	quickpose.setMaxBoneLength(1,  8,  L18   + 0.1f); std::cout << "L18: " << L18 << std::endl;
-	quickpose.setMaxBoneLength(8,  9,  L89   + 0.1f); std::cout << "L89: " << L89 << std::endl;
-	quickpose.setMaxBoneLength(9,  10, L910  + 0.1f); std::cout << "L910: " << L910 << std::endl;
-	quickpose.setMaxBoneLength(10, 11, L1011 + 0.1f); std::cout << "L1011: " << L1011 << std::endl;
-	quickpose.setMaxBoneLength(8,  12, L812  + 0.1f); std::cout << "L812: " << L812 << std::endl;
-	quickpose.setMaxBoneLength(12, 13, L1213 + 0.1f); std::cout << "L1213: " << L1213 << std::endl;
-	quickpose.setMaxBoneLength(13, 14, L1314 + 0.1f); std::cout << "L1314: " << L1314 << std::endl;
-	
-	quickpose.setMaxBoneLength(2, 17, L01 + L12 + 0.1f);
-	quickpose.setMaxBoneLength(5, 18, L01 + L15 + 0.1f);
+	/* maximum lengths only, learned from the 4DA ground truth in the Shelf layout */
+	auto multiPersonPosesBones = T4DALoader::loadGroundTruth("../Dataset/shelf/gt.txt");
+	SkeletonConverter::shelfToBody25(multiPersonPosesBones);
+	auto boneConstraints = ShelfLoader::learnBoneConstraints(multiPersonPosesBones, quickpose.getParents());
+	boneConstraints.widen(BONE_LENGTH_MARGIN);
+	quickpose.setBoneConstraints(boneConstraints);
 	
 	multiPersonPosesGT = ShelfLoader::loadGroundTruth("../Dataset/shelf/shelf.gt.txt");
-	shelfToBody25(multiPersonPosesGT);
+	SkeletonConverter::shelfToBody25(multiPersonPosesGT);
 	
 	multiPersonPoses4DA = T4DALoader::loadGroundTruth("../Dataset/shelf/skel.txt");
-	skel19ToBody25(multiPersonPoses4DA);
+	SkeletonConverter::skel19ToBody25(multiPersonPoses4DA);
+	
+	pipeline.setPostProcess(SkeletonConverter::correctShelfAtBody25);
+	/* the viewer still runs without the stream, poses are just not published */
+	isPublishing = poseStream.open("/mmmocap-poses", 25);
+	if (!isPublishing) std::cerr << "Main Error: Pose stream is not open, poses are not published\n";
+	pipeline.setOutput([](PipelineFrame&& frame) -> void {
+		if (isPublishing) poseStream.publish(frame.multiPersonPose, frame.index, frame.multiview.timestamp);
+		finishedFrames.push(std::move(frame));
+	});
+	pipeline.start();
 	
 //	for (int i = 300; i <= 600; ++i) {
 //		std::ifstream stream("/Users/hypertheory/Library/Containers/com.tencent.xinWeChat/Data/Library/"
@@ -316,34 +135,23 @@ void prepare() {
 //
 //		stream.close();
 //	}
-//	coco17ToBody25(multiPersonPoses4DA);
+//	SkeletonConverter::coco17ToBody25(multiPersonPoses4DA);
 }
 
 bool isComputed = true;
 
-void execute(int frame) {
+/* computed frames go through the pipeline and are picked up by update() */
+bool execute(int frame) {
 	if (isComputed) {
-		auto& multiview = multiviews[frame];
-		multiview.computeEpipolar(MAX_EPIPOLAR_DISTANCE);
-		computedMultiPersonPose = quickpose.compute(multiview);
-		correctShelfAtBody25(computedMultiPersonPose);
-	} else {
-		computedMultiPersonPose = multiPersonPoses4DA[frame];
-		correctShelfAtBody25(computedMultiPersonPose);
+		return pipeline.trySubmit(PipelineFrame(frame, multiviews[frame]));
 	}
+	computedMultiPersonPose = multiPersonPoses4DA[frame];
+	SkeletonConverter::correctShelfAtBody25(computedMultiPersonPose);
 //	std::cout << "Count: " << quickpose.count << std::endl;
+	return true;
 }
 
 void evaluate(int frame) {
-	static float accumA1 = 0;
-	static float totalA1 = 0;
-	
-	static float accumA2 = 0;
-	static float totalA2 = 0;
-	
-	static float accumA3 = 0;
-	static float totalA3 = 0;
-	
 	std::vector<int> boneA = {
 		5, 2, 6, 3, 12, 9, 13, 10, 1, 1, 1, 1, 8, 8, 2, 5
 	};
@@ -357,111 +165,67 @@ void evaluate(int frame) {
 	OneRoom::cleanUpJointsAndBones();
 	
 	for (auto& pose : multiPersonPose) {
-		if (pose.hasJoint.empty()) continue;
+		if (pose.isEmpty()) continue;
 		for (int type = 0; type < 15; ++type) {
-			if (!pose.hasJoint[type]) continue;
+			if (!pose.hasJoint(type)) continue;
 			OneRoom::setJoint(mapping(pose.jointPos[type]));
 		}
-		if (pose.hasJoint[17]) {
+		if (pose.hasJoint(17)) {
 			OneRoom::setJoint(mapping(pose.jointPos[17]));
 		}
-		if (pose.hasJoint[18]) {
+		if (pose.hasJoint(18)) {
 			OneRoom::setJoint(mapping(pose.jointPos[18]));
 		}
 		
 		size_t boneSize = boneA.size();
 		for (int bone = 0; bone < boneSize; ++bone) {
-			if (!pose.hasJoint[boneA[bone]] || !pose.hasJoint[boneB[bone]]) continue;
+			if (!pose.hasJoint(boneA[bone]) || !pose.hasJoint(boneB[bone])) continue;
 			auto posA = mapping(pose.jointPos[boneA[bone]]);
 			auto posB = mapping(pose.jointPos[boneB[bone]]);
 			OneRoom::setBone(posA, posB, OneRoom::DEFAULT_COLOR);
 		}
 	}
 	
-	for (auto& poseGT : multiPersonPoseGT) {
-		if (poseGT.ID == 4) continue;
-		if (poseGT.hasJoint.empty()) continue;
-		
-		std::vector<bool> boneTests(boneA.size(), true);
-		
-		Pose* closestPose = nullptr;
-		float minPoseDistance = std::numeric_limits<float>::max();
-		for (auto& pose : multiPersonPose) {
-			if (pose.hasJoint.empty()) continue;
-			float poseDistance = 0;
-			float poseNum = 0;
-			for (int type = 0; type < 15; ++type) {
-				if (pose.hasJoint[type] && poseGT.hasJoint[type]) {
-					poseDistance += pose.jointPos[type].distance(poseGT.jointPos[type]);
-					poseNum += 1.f;
-				}
-			}
-			if (poseNum == 0) continue;
-			poseDistance /= poseNum;
-			if (poseDistance < minPoseDistance) {
-				closestPose = &pose;
-				minPoseDistance = poseDistance;
-			}
-		}
+	auto matches = evaluator.match(multiPersonPoseGT, multiPersonPose);
+	
+	size_t personNumGT = multiPersonPoseGT.size();
+	for (int personGT = 0; personGT < personNumGT; ++personGT) {
+		auto& poseGT = multiPersonPoseGT[personGT];
+		if (evaluator.isIgnored(poseGT)) continue;
 		
-		if (closestPose != nullptr) {
-			size_t boneSize = boneA.size();
-			for (int bone = 0; bone < boneSize; ++bone) {
-				if (!poseGT.hasJoint[boneA[bone]] || !poseGT.hasJoint[boneB[bone]]) continue;
-				if (!closestPose->hasJoint[boneA[bone]] || !closestPose->hasJoint[boneB[bone]]) {
-					boneTests[bone] = false;
-					continue;
-				}
-				auto posA = closestPose->jointPos[boneA[bone]];
-				auto posB = closestPose->jointPos[boneB[bone]];
-				auto posGTA = poseGT.jointPos[boneA[bone]];
-				auto posGTB = poseGT.jointPos[boneB[bone]];
-				boneTests[bone] = posA.distance(posGTA) + posB.distance(posGTB) < posGTA.distance(posGTB);
-			}
-		}
+		const Pose* closestPose = matches[personGT] == -1 ? nullptr : &multiPersonPose[matches[personGT]];
 		
 		for (int type = 0; type < 15; ++type) {
-			if (!poseGT.hasJoint[type]) continue;
+			if (!poseGT.hasJoint(type)) continue;
 			OneRoom::setJoint(mapping(poseGT.jointPos[type]));
 		}
 		
 		size_t boneSize = boneA.size();
 		for (int bone = 0; bone < boneSize; ++bone) {
-			if (!poseGT.hasJoint[boneA[bone]] || !poseGT.hasJoint[boneB[bone]]) continue;
+			if (!poseGT.hasJoint(boneA[bone]) || !poseGT.hasJoint(boneB[bone])) continue;
 			auto posA = mapping(poseGT.jointPos[boneA[bone]]);
 			auto posB = mapping(poseGT.jointPos[boneB[bone]]);
-			if (bone >= 10) {
+			if (bone >= evaluator.getBoneNum()) {
 				OneRoom::setBone(posA, posB, WHITE);
 				continue;
 			}
-			OneRoom::setBone(posA, posB, boneTests[bone] ? GREEN : RED);
-		}
-		
-		for (int bone = 0; bone < boneSize; ++bone) {
-			if (bone >= 10) continue;
-			if (poseGT.ID == 1) {
-				accumA1 += boneTests[bone];
-				totalA1 += 1.;
-			} else if (poseGT.ID == 2) {
-				accumA2 += boneTests[bone];
-				totalA2 += 1.;
-			} else if (poseGT.ID == 3) {
-				accumA3 += boneTests[bone];
-				totalA3 += 1.;
-			}
+			bool isCorrect = closestPose != nullptr && evaluator.testBone(poseGT, *closestPose, bone);
+			OneRoom::setBone(posA, posB, isCorrect ? GREEN : RED);
 		}
 	}
 	
-	float PCPA1 = accumA1 / totalA1;
-	float PCPA2 = accumA2 / totalA2;
-	float PCPA3 = accumA3 / totalA3;
-	float PCPAvg = (PCPA1 + PCPA2 + PCPA3) / 3.;
+	evaluation.merge(evaluator.evaluate(multiPersonPoseGT, multiPersonPose));
 	
 	std::cout << "Frame: " << frame << std::string(4 - std::to_string(frame).size(), ' ');
-	std::cout << " | PCP | A1: " << (isnan(PCPA1) ? "N/A     " : std::to_string(PCPA1));
-	std::cout << " | A2: " << (isnan(PCPA2) ? "N/A     " : std::to_string(PCPA2));
-	std::cout << " | A3: " << (isnan(PCPA3) ? "N/A     " : std::to_string(PCPA3));
+	std::cout << " | PCP";
+	for (auto& [ID, actor] : evaluation.actors) {
+		float PCP = actor.getPCP();
+		std::cout << " | A" << ID << ": " << (isnan(PCP) ? "N/A     " : std::to_string(PCP));
+	}
+	float PCPAvg = evaluation.getPCP();
+	float MPJPE = evaluation.getMPJPE();
 	std::cout << " | Avg: " << (isnan(PCPAvg) ? "N/A     " : std::to_string(PCPAvg));
+	std::cout << " | MPJPE: " << (isnan(MPJPE) ? "N/A     " : std::to_string(MPJPE));
 	std::cout << "\n";
 }
 
@@ -526,12 +290,20 @@ void update(float dt) {
 		isComputed = !isComputed;
 	}
 	
-	if (needsUpdate) {
+	if (needsUpdate && execute(frameIndex)) {
 		std::cout << (isComputed ? "Quickpose now\n" : "4DAssociation now\n");
-		execute(frameIndex);
-		evaluate(frameIndex);
+		if (!isComputed) {
+			evaluate(frameIndex);
+			Ink::Window::set_title("Frame: " + std::to_string(frameIndex));
+		}
 		needsUpdate = false;
-		Ink::Window::set_title("Frame: " + std::to_string(frameIndex));
+	}
+	
+	PipelineFrame finishedFrame;
+	while (finishedFrames.tryPop(finishedFrame)) {
+		computedMultiPersonPose = std::move(finishedFrame.multiPersonPose);
+		evaluate(finishedFrame.index);
+		Ink::Window::set_title("Frame: " + std::to_string(finishedFrame.index));
 	}
 	
 	OneRoom::update(dt);
@@ -548,29 +320,32 @@ void update(float dt) {
 	}
 	
 	if (Ink::Window::is_down(SDLK_1)) {
-		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex].views[0],
+		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex], 0,
 								DATASET_DIR + fmt::format("/Camera{}/img_{:0>6d}.png", 0, frameIndex + 300));
 	}
 	
 	if (Ink::Window::is_pressed(SDLK_2)) {
-		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex].views[1],
+		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex], 1,
 								DATASET_DIR + fmt::format("/Camera{}/img_{:0>6d}.png", 1, frameIndex + 300));
 	}
 	
 	if (Ink::Window::is_pressed(SDLK_3)) {
-		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex].views[2],
+		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex], 2,
 								DATASET_DIR + fmt::format("/Camera{}/img_{:0>6d}.png", 2, frameIndex + 300));
 	}
 	
 	if (Ink::Window::is_pressed(SDLK_4)) {
-		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex].views[3],
+		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex], 3,
 								DATASET_DIR + fmt::format("/Camera{}/img_{:0>6d}.png", 3, frameIndex + 300));
 	}
 	
 	if (Ink::Window::is_pressed(SDLK_5)) {
-		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex].views[4],
+		Visualizer2D::visualize(computedMultiPersonPose, multiviews[frameIndex], 4,
 								DATASET_DIR + fmt::format("/Camera{}/img_{:0>6d}.png", 4, frameIndex + 300));
 	}
 }
 
-void quit() {}
+void quit() {
+	finishedFrames.close();
+	pipeline.finish();
+}
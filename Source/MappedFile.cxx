@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+	open(path);
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	
+	int descriptor = ::open(path.c_str(), O_RDONLY);
+	if (descriptor == -1) return false;
+	
+	struct stat status = {};
+	if (fstat(descriptor, &status) == -1) {
+		::close(descriptor);
+		return false;
+	}
+	length = static_cast<size_t>(status.st_size);
+	modifiedTime = static_cast<long long>(status.st_mtime);
+	
+	/* an empty file is valid but cannot be mapped */
+	if (length != 0) {
+		address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (address == MAP_FAILED) {
+			address = nullptr;
+			length = 0;
+			::close(descriptor);
+			return false;
+		}
+		madvise(address, length, MADV_SEQUENTIAL);
+	}
+	
+	::close(descriptor);
+	isMapped = true;
+	return true;
+}
+
+void MappedFile::close() {
+	if (address != nullptr) munmap(address, length);
+	address = nullptr;
+	length = 0;
+	modifiedTime = 0;
+	isMapped = false;
+}
+
+bool MappedFile::isOpen() const {
+	return isMapped;
+}
+
+const char* MappedFile::data() const {
+	return static_cast<const char*>(address);
+}
+
+size_t MappedFile::size() const {
+	return length;
+}
+
+long long MappedFile::getModifiedTime() const {
+	return modifiedTime;
+}
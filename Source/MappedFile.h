@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+
+class MappedFile {
+public:
+	explicit MappedFile() = default;
+	
+	explicit MappedFile(const std::string& path);
+	
+	~MappedFile();
+	
+	MappedFile(const MappedFile&) = delete;
+	
+	MappedFile& operator=(const MappedFile&) = delete;
+	
+	bool open(const std::string& path);
+	
+	void close();
+	
+	bool isOpen() const;
+	
+	const char* data() const;
+	
+	size_t size() const;
+	
+	long long getModifiedTime() const;
+	
+private:
+	void* address = nullptr;
+	
+	size_t length = 0;
+	
+	long long modifiedTime = 0;
+	
+	bool isMapped = false;
+};
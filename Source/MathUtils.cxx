@@ -22,6 +22,8 @@
 
 #include "MathUtils.h"
 
+#include <limits>
+
 float MathUtils::computeRayDistance(const Ink::Ray& ray1, const Ink::Ray& ray2) {
 	if (fabsf(ray1.direction.dot(ray2.direction)) < 0.0001f) {
 		return (ray1.origin - ray2.origin).cross(ray1.direction).magnitude();
@@ -29,6 +31,43 @@ float MathUtils::computeRayDistance(const Ink::Ray& ray1, const Ink::Ray& ray2)
 	return fabsf((ray1.origin - ray2.origin).dot(ray1.direction.cross(ray2.direction).normalize()));
 }
 
+void MathUtils::computeRayDistances(const Ink::Vec3& baseline, const Ink::Vec3& direction,
+									const float* x, const float* y, const float* z,
+									size_t size, float* distances) {
+	/* baseline = origin1 - origin2, direction = direction1, (x, y, z) = direction2 */
+	Ink::Vec3 parallel = baseline.cross(direction);
+	float parallelDistance = parallel.magnitude();
+	for (size_t i = 0; i < size; ++i) {
+		float cx = direction.y * z[i] - direction.z * y[i];
+		float cy = direction.z * x[i] - direction.x * z[i];
+		float cz = direction.x * y[i] - direction.y * x[i];
+		float dot = direction.x * x[i] + direction.y * y[i] + direction.z * z[i];
+		float distance = fabsf(baseline.x * cx + baseline.y * cy + baseline.z * cz) /
+			sqrtf(cx * cx + cy * cy + cz * cz);
+		distances[i] = fabsf(dot) < 0.0001f ? parallelDistance : distance;
+	}
+}
+
+void MathUtils::computeEpipolarLineDistances(const Ink::Mat3& fundamental, const Ink::Vec2& uvA,
+											 const Ink::Vec2* uvsB, size_t size, float* distances) {
+	/* line of uvA in view B, F * uvA */
+	const float* F[3] = {fundamental[0], fundamental[1], fundamental[2]};
+	float la = F[0][0] * uvA.x + F[0][1] * uvA.y + F[0][2];
+	float lb = F[1][0] * uvA.x + F[1][1] * uvA.y + F[1][2];
+	float lc = F[2][0] * uvA.x + F[2][1] * uvA.y + F[2][2];
+	float lineNormB = 1.f / sqrtf(la * la + lb * lb);
+	
+	/* the line of uvB in view A is F^T * uvB, both lines share the algebraic error uvB^T F uvA */
+	for (size_t i = 0; i < size; ++i) {
+		float u = uvsB[i].x;
+		float v = uvsB[i].y;
+		float error = fabsf(la * u + lb * v + lc);
+		float ma = F[0][0] * u + F[1][0] * v + F[2][0];
+		float mb = F[0][1] * u + F[1][1] * v + F[2][1];
+		distances[i] = 0.5f * error * (lineNormB + 1.f / sqrtf(ma * ma + mb * mb));
+	}
+}
+
 Ink::Vec3 MathUtils::multiRayIntersect(const Ink::Ray** rays, size_t size) {
 	Ink::Mat3 A;
 	Ink::Vec3 b;
@@ -64,3 +103,198 @@ Ink::Vec3 MathUtils::multiRayIntersect(const Ink::Ray** rays, float* confs, size
 	}
 	return Ink::inverse_3x3(A) * b;
 }
+
+Ink::Vec3 MathUtils::multiRayIntersect(const Ink::Vec3* origins, const Ink::Vec3* directions, size_t size) {
+	Ink::Mat3 A;
+	Ink::Vec3 b;
+	for (int i = 0; i < size; ++i) {
+		auto& dx = directions[i].x;
+		auto& dy = directions[i].y;
+		auto& dz = directions[i].z;
+		Ink::Mat3 N = {
+			dx * dx - 1.f, dx * dy, dx * dz,
+			dy * dx, dy * dy - 1.f, dy * dz,
+			dz * dx, dz * dy, dz * dz - 1.f,
+		};
+		A += N;
+		b += N * origins[i];
+	}
+	return Ink::inverse_3x3(A) * b;
+}
+
+void MathUtils::solveAssignment(const float* costs, int rowNum, int colNum, int* assignment) {
+	/* Hungarian algorithm with potentials, the smaller side is assigned completely */
+	bool isTransposed = rowNum > colNum;
+	int n = isTransposed ? colNum : rowNum;
+	int m = isTransposed ? rowNum : colNum;
+	auto cost = [&](int i, int j) -> double {
+		return isTransposed ? costs[j * colNum + i] : costs[i * colNum + j];
+	};
+	
+	constexpr double INF = std::numeric_limits<double>::max();
+	std::vector<double> u(n + 1, 0), v(m + 1, 0), minv(m + 1);
+	std::vector<int> p(m + 1, 0), way(m + 1, 0);
+	std::vector<bool> used(m + 1);
+	
+	for (int i = 1; i <= n; ++i) {
+		p[0] = i;
+		int j0 = 0;
+		std::fill(minv.begin(), minv.end(), INF);
+		std::fill(used.begin(), used.end(), false);
+		do {
+			used[j0] = true;
+			int i0 = p[j0];
+			int j1 = 0;
+			double delta = INF;
+			for (int j = 1; j <= m; ++j) {
+				if (used[j]) continue;
+				double cur = cost(i0 - 1, j - 1) - u[i0] - v[j];
+				if (cur < minv[j]) {
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if (minv[j] < delta) {
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= m; ++j) {
+				if (used[j]) {
+					u[p[j]] += delta;
+					v[j] -= delta;
+				} else {
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (p[j0] != 0);
+		do {
+			int j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+	
+	std::fill(assignment, assignment + rowNum, -1);
+	for (int j = 1; j <= m; ++j) {
+		if (p[j] == 0) continue;
+		if (isTransposed) {
+			assignment[j - 1] = p[j] - 1;
+		} else {
+			assignment[p[j] - 1] = j - 1;
+		}
+	}
+}
+
+Ink::Mat3 MathUtils::solveRotation(const Ink::Vec3* source, const Ink::Vec3* target, size_t size) {
+	/* rotation that best maps the source vectors onto the target vectors, using Horn's quaternion method */
+	double S[3][3] = {};
+	for (int i = 0; i < size; ++i) {
+		const Ink::Vec3& x = source[i];
+		const Ink::Vec3& y = target[i];
+		float xs[3] = {x.x, x.y, x.z};
+		float ys[3] = {y.x, y.y, y.z};
+		for (int a = 0; a < 3; ++a) {
+			for (int b = 0; b < 3; ++b) {
+				S[a][b] += xs[a] * ys[b];
+			}
+		}
+	}
+	
+	double N[4][4] = {
+		{S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1], S[2][0] - S[0][2], S[0][1] - S[1][0]},
+		{S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2], S[0][1] + S[1][0], S[2][0] + S[0][2]},
+		{S[2][0] - S[0][2], S[0][1] + S[1][0], -S[0][0] + S[1][1] - S[2][2], S[1][2] + S[2][1]},
+		{S[0][1] - S[1][0], S[2][0] + S[0][2], S[1][2] + S[2][1], -S[0][0] - S[1][1] + S[2][2]},
+	};
+	
+	/* cyclic Jacobi rotations, the eigenvectors are accumulated in V */
+	double V[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+	for (int sweep = 0; sweep < 32; ++sweep) {
+		double offDiagonal = 0;
+		for (int p = 0; p < 4; ++p) {
+			for (int q = p + 1; q < 4; ++q) {
+				offDiagonal += N[p][q] * N[p][q];
+			}
+		}
+		if (offDiagonal < 1e-20) break;
+		for (int p = 0; p < 4; ++p) {
+			for (int q = p + 1; q < 4; ++q) {
+				if (fabs(N[p][q]) < 1e-30) continue;
+				double theta = (N[q][q] - N[p][p]) / (2 * N[p][q]);
+				double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+				double c = 1 / sqrt(t * t + 1);
+				double s = t * c;
+				for (int k = 0; k < 4; ++k) {
+					double nkp = N[k][p];
+					double nkq = N[k][q];
+					N[k][p] = c * nkp - s * nkq;
+					N[k][q] = s * nkp + c * nkq;
+				}
+				for (int k = 0; k < 4; ++k) {
+					double npk = N[p][k];
+					double nqk = N[q][k];
+					N[p][k] = c * npk - s * nqk;
+					N[q][k] = s * npk + c * nqk;
+				}
+				for (int k = 0; k < 4; ++k) {
+					double vkp = V[k][p];
+					double vkq = V[k][q];
+					V[k][p] = c * vkp - s * vkq;
+					V[k][q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+	
+	int maxI = 0;
+	for (int i = 1; i < 4; ++i) {
+		if (N[i][i] > N[maxI][maxI]) maxI = i;
+	}
+	double w = V[0][maxI], x = V[1][maxI], y = V[2][maxI], z = V[3][maxI];
+	return {
+		static_cast<float>(1 - 2 * (y * y + z * z)),
+		static_cast<float>(2 * (x * y - w * z)),
+		static_cast<float>(2 * (x * z + w * y)),
+		static_cast<float>(2 * (x * y + w * z)),
+		static_cast<float>(1 - 2 * (x * x + z * z)),
+		static_cast<float>(2 * (y * z - w * x)),
+		static_cast<float>(2 * (x * z - w * y)),
+		static_cast<float>(2 * (y * z + w * x)),
+		static_cast<float>(1 - 2 * (x * x + y * y)),
+	};
+}
+
+void MathUtils::procrustesAlign(const Ink::Vec3* source, const Ink::Vec3* target, size_t size, Ink::Vec3* aligned) {
+	/* similarity transform from source to target, the rotation is solved on the centered points */
+	Ink::Vec3 sourceCenter;
+	Ink::Vec3 targetCenter;
+	for (int i = 0; i < size; ++i) {
+		sourceCenter += source[i];
+		targetCenter += target[i];
+	}
+	sourceCenter /= static_cast<float>(size);
+	targetCenter /= static_cast<float>(size);
+	
+	std::vector<Ink::Vec3> centeredSource(size);
+	std::vector<Ink::Vec3> centeredTarget(size);
+	double sourceNorm = 0;
+	for (int i = 0; i < size; ++i) {
+		centeredSource[i] = source[i] - sourceCenter;
+		centeredTarget[i] = target[i] - targetCenter;
+		sourceNorm += centeredSource[i].dot(centeredSource[i]);
+	}
+	
+	Ink::Mat3 R = solveRotation(centeredSource.data(), centeredTarget.data(), size);
+	
+	double correlation = 0;
+	for (int i = 0; i < size; ++i) {
+		Ink::Vec3 rotated = R * (source[i] - sourceCenter);
+		correlation += rotated.dot(target[i] - targetCenter);
+	}
+	float scale = sourceNorm > 0 ? static_cast<float>(correlation / sourceNorm) : 1.f;
+	
+	for (int i = 0; i < size; ++i) {
+		aligned[i] = Ink::Vec3(R * (source[i] - sourceCenter)) * scale + targetCenter;
+	}
+}
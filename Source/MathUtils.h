@@ -28,7 +28,23 @@ class MathUtils {
 public:
 	static float computeRayDistance(const Ink::Ray& ray1, const Ink::Ray& ray2);
 	
+	static void computeRayDistances(const Ink::Vec3& baseline, const Ink::Vec3& direction,
+									const float* x, const float* y, const float* z,
+									size_t size, float* distances);
+	
+	/* mean distance of uvA to the epipolar line of each uvB and of each uvB to the line of uvA, in pixels */
+	static void computeEpipolarLineDistances(const Ink::Mat3& fundamental, const Ink::Vec2& uvA,
+											 const Ink::Vec2* uvsB, size_t size, float* distances);
+	
 	static Ink::Vec3 multiRayIntersect(const Ink::Ray** rays, size_t size);
 	
 	static Ink::Vec3 multiRayIntersect(const Ink::Ray** rays, float* confs, size_t size);
+	
+	static Ink::Vec3 multiRayIntersect(const Ink::Vec3* origins, const Ink::Vec3* directions, size_t size);
+	
+	static void solveAssignment(const float* costs, int rowNum, int colNum, int* assignment);
+	
+	static Ink::Mat3 solveRotation(const Ink::Vec3* source, const Ink::Vec3* target, size_t size);
+	
+	static void procrustesAlign(const Ink::Vec3* source, const Ink::Vec3* target, size_t size, Ink::Vec3* aligned);
 };
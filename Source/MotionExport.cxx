@@ -0,0 +1,383 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MotionExport.h"
+#include "MathUtils.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <iostream>
+
+constexpr size_t STREAM_BUFFER_SIZE = 1 << 20;
+
+/* fixed width of the patched frame count in the BVH header */
+constexpr int FRAME_NUM_WIDTH = 12;
+
+/* NPY headers are padded to a fixed size so the shape can be rewritten in place */
+constexpr size_t NPY_HEADER_SIZE = 128;
+
+static Ink::Mat3 rotationBetween(const Ink::Vec3& source, const Ink::Vec3& target) {
+	Ink::Vec3 a = source.normalize();
+	Ink::Vec3 b = target.normalize();
+	Ink::Vec3 axis = a.cross(b);
+	float sine = axis.magnitude();
+	float cosine = a.dot(b);
+	if (sine < 1e-6f) {
+		if (cosine > 0) return Ink::Mat3::identity();
+		/* half turn about any axis perpendicular to the source */
+		Ink::Vec3 normal = fabs(a.x) < 0.9f ? Ink::Vec3(1, 0, 0) : Ink::Vec3(0, 1, 0);
+		Ink::Vec3 n = a.cross(normal).normalize();
+		return {
+			2 * n.x * n.x - 1, 2 * n.x * n.y    , 2 * n.x * n.z    ,
+			2 * n.y * n.x    , 2 * n.y * n.y - 1, 2 * n.y * n.z    ,
+			2 * n.z * n.x    , 2 * n.z * n.y    , 2 * n.z * n.z - 1,
+		};
+	}
+	Ink::Vec3 n = axis / sine;
+	float t = 1 - cosine;
+	return {
+		t * n.x * n.x + cosine      , t * n.x * n.y - sine * n.z, t * n.x * n.z + sine * n.y,
+		t * n.y * n.x + sine * n.z, t * n.y * n.y + cosine      , t * n.y * n.z - sine * n.x,
+		t * n.z * n.x - sine * n.y, t * n.z * n.y + sine * n.x, t * n.z * n.z + cosine      ,
+	};
+}
+
+BVHWriter::~BVHWriter() {
+	close();
+}
+
+bool BVHWriter::open(const std::string& path, const std::vector<int>& parents, const std::vector<Ink::Vec3>& offsets,
+					 float frameTime, const std::vector<std::string>& names) {
+	close();
+	
+	int jointNum = static_cast<int>(parents.size());
+	this->parents = parents;
+	this->offsets = offsets;
+	children.assign(jointNum, {});
+	root = -1;
+	for (int joint = 0; joint < jointNum; ++joint) {
+		if (parents[joint] == -1) {
+			if (root == -1) root = joint;
+		} else {
+			children[parents[joint]].emplace_back(joint);
+		}
+	}
+	if (root == -1 || offsets.size() != jointNum) {
+		std::cerr << "BVHWriter Error: Invalid skeleton\n";
+		return false;
+	}
+	
+	buffer.resize(STREAM_BUFFER_SIZE);
+	stream.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	stream.open(path, std::ios::out | std::ios::trunc);
+	if (stream.fail()) {
+		std::cerr << "BVHWriter Error: Failed to open " << path << "\n";
+		return false;
+	}
+	
+	std::vector<std::string> jointNames = names;
+	for (int joint = static_cast<int>(jointNames.size()); joint < jointNum; ++joint) {
+		jointNames.emplace_back("Joint" + std::to_string(joint));
+	}
+	
+	order.clear();
+	stream << "HIERARCHY\n";
+	writeJoint(root, 0, jointNames);
+	stream << "MOTION\nFrames: ";
+	frameNumPosition = stream.tellp();
+	stream << std::string(FRAME_NUM_WIDTH, ' ') << "\n";
+	stream << fmt::format("Frame Time: {:.6f}\n", frameTime);
+	
+	frameNum = 0;
+	rootPos = Ink::Vec3();
+	rotations.assign(jointNum, Ink::Mat3::identity());
+	line.clear();
+	return true;
+}
+
+void BVHWriter::write(const Pose& pose) {
+	auto hasJoint = [&pose](int joint) -> bool {
+		return joint < Pose::JOINT_NUM && pose.hasJoint(joint);
+	};
+	
+	/* a missing root keeps its previous position */
+	if (hasJoint(root)) rootPos = pose.jointPos[root];
+	
+	/*
+	 * Global rotations map rest offsets onto the current bones, parents first.
+	 * A single child bone turns by the shortest arc from the parent frame, so
+	 * it inherits the parent twist. Several children fix the twist by a best
+	 * fit rotation. Joints without visible children follow their parent.
+	 */
+	std::vector<Ink::Vec3> restBones;
+	std::vector<Ink::Vec3> bones;
+	for (int joint : order) {
+		int parent = parents[joint];
+		Ink::Mat3 parentRotation = parent == -1 ? Ink::Mat3::identity() : rotations[parent];
+		
+		restBones.clear();
+		bones.clear();
+		if (hasJoint(joint)) {
+			for (int child : children[joint]) {
+				if (!hasJoint(child) || offsets[child].magnitude() < 1e-6f) continue;
+				restBones.emplace_back(offsets[child]);
+				bones.emplace_back(pose.jointPos[child] - pose.jointPos[joint]);
+			}
+		}
+		
+		if (bones.empty()) {
+			rotations[joint] = parentRotation;
+		} else if (bones.size() == 1) {
+			Ink::Vec3 restBone = parentRotation * restBones[0];
+			rotations[joint] = rotationBetween(restBone, bones[0]) * parentRotation;
+		} else {
+			rotations[joint] = MathUtils::solveRotation(restBones.data(), bones.data(), bones.size());
+		}
+	}
+	
+	line.clear();
+	auto out = std::back_inserter(line);
+	fmt::format_to(out, "{:.5f} {:.5f} {:.5f}", rootPos.x, rootPos.y, rootPos.z);
+	
+	constexpr float DEGREE = 57.29577951f;
+	for (int joint : order) {
+		int parent = parents[joint];
+		Ink::Mat3 local = parent == -1 ? rotations[joint] : rotations[parent].transpose() * rotations[joint];
+		
+		/* local = Rz * Rx * Ry */
+		float x = asinf(fmax(-1.f, fmin(1.f, local[2][1])));
+		float z = atan2f(-local[0][1], local[1][1]);
+		float y = atan2f(-local[2][0], local[2][2]);
+		fmt::format_to(out, " {:.4f} {:.4f} {:.4f}", z * DEGREE, x * DEGREE, y * DEGREE);
+	}
+	line += '\n';
+	
+	stream << line;
+	++frameNum;
+}
+
+void BVHWriter::repeat() {
+	if (line.empty()) return;
+	stream << line;
+	++frameNum;
+}
+
+void BVHWriter::close() {
+	if (!stream.is_open()) return;
+	stream.seekp(frameNumPosition);
+	stream << frameNum;
+	stream.close();
+}
+
+size_t BVHWriter::getFrameNum() const {
+	return frameNum;
+}
+
+std::vector<Ink::Vec3> BVHWriter::computeOffsets(const Pose& restPose, const std::vector<int>& parents) {
+	std::vector<Ink::Vec3> offsets(parents.size());
+	for (int joint = 0; joint < parents.size(); ++joint) {
+		int parent = parents[joint];
+		if (joint >= Pose::JOINT_NUM || !restPose.hasJoint(joint)) continue;
+		if (parent == -1) {
+			offsets[joint] = restPose.jointPos[joint];
+		} else if (restPose.hasJoint(parent)) {
+			offsets[joint] = restPose.jointPos[joint] - restPose.jointPos[parent];
+		}
+	}
+	return offsets;
+}
+
+std::vector<std::string> BVHWriter::getBody25Names() {
+	return {
+		"Nose", "Neck", "RShoulder", "RElbow", "RWrist", "LShoulder", "LElbow", "LWrist", "MidHip",
+		"RHip", "RKnee", "RAnkle", "LHip", "LKnee", "LAnkle", "REye", "LEye", "REar", "LEar",
+		"LBigToe", "LSmallToe", "LHeel", "RBigToe", "RSmallToe", "RHeel",
+	};
+}
+
+void BVHWriter::writeJoint(int joint, int depth, const std::vector<std::string>& names) {
+	order.emplace_back(joint);
+	
+	std::string indent(depth, '\t');
+	const Ink::Vec3& offset = offsets[joint];
+	if (depth == 0) {
+		stream << "ROOT " << names[joint] << "\n{\n";
+		stream << "\tOFFSET 0 0 0\n";
+		stream << "\tCHANNELS 6 Xposition Yposition Zposition Zrotation Xrotation Yrotation\n";
+	} else {
+		stream << indent << "JOINT " << names[joint] << "\n" << indent << "{\n";
+		stream << indent << fmt::format("\tOFFSET {:.5f} {:.5f} {:.5f}\n", offset.x, offset.y, offset.z);
+		stream << indent << "\tCHANNELS 3 Zrotation Xrotation Yrotation\n";
+	}
+	
+	for (int child : children[joint]) {
+		writeJoint(child, depth + 1, names);
+	}
+	if (children[joint].empty()) {
+		stream << indent << "\tEnd Site\n" << indent << "\t{\n";
+		stream << indent << "\t\tOFFSET 0 0 0\n" << indent << "\t}\n";
+	}
+	
+	stream << indent << "}\n";
+}
+
+bool BVHExporter::open(const std::string& pathPrefix, const std::vector<int>& parents,
+					   const std::vector<Ink::Vec3>& offsets, float frameTime, const std::vector<std::string>& names) {
+	close();
+	
+	/* the files open per person later, so the skeleton is checked up front */
+	bool hasRoot = std::find(parents.begin(), parents.end(), -1) != parents.end();
+	if (!hasRoot || (!offsets.empty() && offsets.size() != parents.size())) {
+		std::cerr << "BVHExporter Error: Invalid skeleton\n";
+		return false;
+	}
+	
+	this->pathPrefix = pathPrefix;
+	this->parents = parents;
+	this->offsets = offsets;
+	this->frameTime = frameTime;
+	this->names = names;
+	return true;
+}
+
+void BVHExporter::write(const MultiPersonPose& multiPersonPose) {
+	for (auto& [ID, writer] : writers) {
+		if (!writer) continue;
+		bool isPresent = false;
+		for (auto& pose : multiPersonPose) {
+			isPresent |= pose.ID == ID;
+		}
+		if (!isPresent) writer->repeat();
+	}
+	
+	for (auto& pose : multiPersonPose) {
+		auto found = writers.find(pose.ID);
+		if (found == writers.end()) {
+			auto writer = std::make_unique<BVHWriter>();
+			const auto& personOffsets = offsets.empty() ? BVHWriter::computeOffsets(pose, parents) : offsets;
+			std::string path = pathPrefix + std::to_string(pose.ID) + ".bvh";
+			if (!writer->open(path, parents, personOffsets, frameTime, names)) {
+				std::cerr << "BVHExporter Error: Dropped person " << pose.ID << "\n";
+				writer.reset();
+			}
+			found = writers.emplace(pose.ID, std::move(writer)).first;
+		}
+		if (found->second) found->second->write(pose);
+	}
+}
+
+void BVHExporter::close() {
+	writers.clear();
+}
+
+PoseArrayWriter::~PoseArrayWriter() {
+	close();
+}
+
+bool PoseArrayWriter::open(const std::string& path, int typeNum, int maxPersonNum, Format format) {
+	close();
+	
+	this->format = format;
+	this->typeNum = typeNum;
+	this->maxPersonNum = maxPersonNum;
+	frameNum = 0;
+	positions.resize(maxPersonNum * typeNum * 4);
+	IDs.resize(maxPersonNum);
+	
+	positionBuffer.resize(STREAM_BUFFER_SIZE);
+	IDBuffer.resize(STREAM_BUFFER_SIZE / 16);
+	positionStream.rdbuf()->pubsetbuf(positionBuffer.data(), static_cast<std::streamsize>(positionBuffer.size()));
+	IDStream.rdbuf()->pubsetbuf(IDBuffer.data(), static_cast<std::streamsize>(IDBuffer.size()));
+	
+	bool isNPY = format == NPY;
+	positionStream.open(path + (isNPY ? ".npy" : ".f32"), std::ios::out | std::ios::binary | std::ios::trunc);
+	IDStream.open(path + (isNPY ? ".ids.npy" : ".ids.i32"), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (positionStream.fail() || IDStream.fail()) {
+		std::cerr << "PoseArrayWriter Error: Failed to open " << path << "\n";
+		positionStream.close();
+		IDStream.close();
+		return false;
+	}
+	
+	if (isNPY) {
+		writeNPYHeader(positionStream, "<f4", fmt::format("{}, {}, 4", maxPersonNum, typeNum));
+		writeNPYHeader(IDStream, "<i4", fmt::format("{}", maxPersonNum));
+	}
+	return true;
+}
+
+void PoseArrayWriter::write(const MultiPersonPose& multiPersonPose) {
+	std::fill(positions.begin(), positions.end(), 0.f);
+	std::fill(IDs.begin(), IDs.end(), -1);
+	
+	int personNum = std::min(static_cast<int>(multiPersonPose.size()), maxPersonNum);
+	for (int person = 0; person < personNum; ++person) {
+		auto& pose = multiPersonPose[person];
+		IDs[person] = pose.ID;
+		float* position = positions.data() + person * typeNum * 4;
+		for (int type = 0; type < typeNum && type < Pose::JOINT_NUM; ++type) {
+			if (!pose.hasJoint(type)) continue;
+			position[type * 4 + 0] = pose.jointPos[type].x;
+			position[type * 4 + 1] = pose.jointPos[type].y;
+			position[type * 4 + 2] = pose.jointPos[type].z;
+			position[type * 4 + 3] = 1;
+		}
+	}
+	
+	positionStream.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(float));
+	IDStream.write(reinterpret_cast<const char*>(IDs.data()), IDs.size() * sizeof(int));
+	++frameNum;
+}
+
+void PoseArrayWriter::close() {
+	if (!positionStream.is_open()) return;
+	
+	if (format == NPY) {
+		positionStream.seekp(0);
+		writeNPYHeader(positionStream, "<f4", fmt::format("{}, {}, 4", maxPersonNum, typeNum));
+		IDStream.seekp(0);
+		writeNPYHeader(IDStream, "<i4", fmt::format("{}", maxPersonNum));
+	}
+	positionStream.close();
+	IDStream.close();
+}
+
+size_t PoseArrayWriter::getFrameNum() const {
+	return frameNum;
+}
+
+void PoseArrayWriter::writeNPYHeader(std::ofstream& stream, const std::string& type, const std::string& innerShape) {
+	std::string header = fmt::format("{{'descr': '{}', 'fortran_order': False, 'shape': ({}, {}), }}",
+									 type, frameNum, innerShape);
+	
+	/* magic, version 1.0 and a little-endian length, then the dictionary padded with spaces */
+	std::string preamble = std::string("\x93NUMPY\x01\x00", 8);
+	size_t dictionarySize = NPY_HEADER_SIZE - preamble.size() - 2;
+	header.resize(dictionarySize - 1, ' ');
+	header += '\n';
+	preamble += static_cast<char>(dictionarySize & 0xff);
+	preamble += static_cast<char>(dictionarySize >> 8);
+	
+	stream.write(preamble.data(), static_cast<std::streamsize>(preamble.size()));
+	stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+}
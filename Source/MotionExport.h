@@ -0,0 +1,172 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Views.h"
+
+#include <fstream>
+#include <map>
+
+/**
+ * Streams the motion of one person to a BVH file. Every joint of the
+ * skeleton becomes a BVH joint, rotations are solved from the joint
+ * positions against the rest offsets, and the frame count is patched in
+ * when the file is closed.
+ */
+class BVHWriter {
+public:
+	explicit BVHWriter() = default;
+	
+	~BVHWriter();
+	
+	BVHWriter(const BVHWriter&) = delete;
+	
+	BVHWriter& operator=(const BVHWriter&) = delete;
+	
+	bool open(const std::string& path, const std::vector<int>& parents, const std::vector<Ink::Vec3>& offsets,
+			  float frameTime, const std::vector<std::string>& names = {});
+	
+	void write(const Pose& pose);
+	
+	/* writes the previous frame again, for frames the person is missing from */
+	void repeat();
+	
+	void close();
+	
+	size_t getFrameNum() const;
+	
+	/* offsets of every joint from its parent in the rest pose */
+	static std::vector<Ink::Vec3> computeOffsets(const Pose& restPose, const std::vector<int>& parents);
+	
+	static std::vector<std::string> getBody25Names();
+	
+private:
+	std::ofstream stream;
+	
+	std::vector<char> buffer;
+	
+	std::streampos frameNumPosition;
+	
+	size_t frameNum = 0;
+	
+	int root = 0;
+	
+	std::vector<int> parents;
+	
+	std::vector<std::vector<int> > children;
+	
+	std::vector<int> order;
+	
+	std::vector<Ink::Vec3> offsets;
+	
+	Ink::Vec3 rootPos;
+	
+	std::vector<Ink::Mat3> rotations;
+	
+	std::string line;
+	
+	void writeJoint(int joint, int depth, const std::vector<std::string>& names);
+};
+
+/**
+ * Writes one BVH file per person ID, a file starts at the first frame of its
+ * person. Without offsets, each person uses its first pose as rest pose.
+ */
+class BVHExporter {
+public:
+	explicit BVHExporter() = default;
+	
+	bool open(const std::string& pathPrefix, const std::vector<int>& parents, const std::vector<Ink::Vec3>& offsets,
+			  float frameTime, const std::vector<std::string>& names = {});
+	
+	void write(const MultiPersonPose& multiPersonPose);
+	
+	void close();
+	
+private:
+	std::string pathPrefix;
+	
+	std::vector<int> parents;
+	
+	std::vector<Ink::Vec3> offsets;
+	
+	float frameTime = 0;
+	
+	std::vector<std::string> names;
+	
+	/* null for persons whose file failed to open, so they are not retried every frame */
+	std::map<int, std::unique_ptr<BVHWriter> > writers;
+};
+
+/**
+ * Streams poses as dense arrays: joint positions of shape (frames, persons,
+ * types, 4) holding xyz and a validity flag, and person IDs of shape
+ * (frames, persons) with -1 for empty slots.
+ */
+class PoseArrayWriter {
+public:
+	enum Format {
+		RAW,
+		NPY,
+	};
+	
+	explicit PoseArrayWriter() = default;
+	
+	~PoseArrayWriter();
+	
+	PoseArrayWriter(const PoseArrayWriter&) = delete;
+	
+	PoseArrayWriter& operator=(const PoseArrayWriter&) = delete;
+	
+	/* writes <path>.npy and <path>.ids.npy, or <path>.f32 and <path>.ids.i32 */
+	bool open(const std::string& path, int typeNum, int maxPersonNum, Format format = NPY);
+	
+	void write(const MultiPersonPose& multiPersonPose);
+	
+	void close();
+	
+	size_t getFrameNum() const;
+	
+private:
+	Format format = NPY;
+	
+	int typeNum = 0;
+	
+	int maxPersonNum = 0;
+	
+	size_t frameNum = 0;
+	
+	std::ofstream positionStream;
+	
+	std::ofstream IDStream;
+	
+	std::vector<char> positionBuffer;
+	
+	std::vector<char> IDBuffer;
+	
+	std::vector<float> positions;
+	
+	std::vector<int> IDs;
+	
+	void writeNPYHeader(std::ofstream& stream, const std::string& type, const std::string& innerShape);
+};
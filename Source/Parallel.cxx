@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int Parallel::threadNum = 0;
+
+int Parallel::getThreadNum() {
+	if (threadNum > 0) return threadNum;
+	return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+void Parallel::setThreadNum(int threadNum) {
+	Parallel::threadNum = threadNum;
+}
+
+void Parallel::forEach(int begin, int end, const std::function<void(int, int)>& func) {
+	int workerNum = std::min(getThreadNum(), end - begin);
+	if (workerNum <= 1) {
+		for (int index = begin; index < end; ++index) func(index, 0);
+		return;
+	}
+	
+	std::atomic<int> next(begin);
+	auto worker = [&](int thread) -> void {
+		for (int index = next++; index < end; index = next++) {
+			func(index, thread);
+		}
+	};
+	
+	std::vector<std::thread> threads;
+	threads.reserve(workerNum - 1);
+	for (int thread = 1; thread < workerNum; ++thread) {
+		threads.emplace_back(worker, thread);
+	}
+	worker(0);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
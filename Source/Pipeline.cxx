@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Pipeline.h"
+
+#include <chrono>
+
+PipelineFrame::PipelineFrame(int index, MultiView multiview) : index(index), multiview(std::move(multiview)) {}
+
+Pipeline::Pipeline(QuickPose& quickpose, size_t queueCapacity) :
+quickpose(quickpose), affinityQueue(queueCapacity), associationQueue(queueCapacity),
+refinementQueue(queueCapacity), outputQueue(queueCapacity) {}
+
+Pipeline::~Pipeline() {
+	finish();
+}
+
+void Pipeline::setPostProcess(const PostProcess& postProcess) {
+	this->postProcess = postProcess;
+}
+
+void Pipeline::setOutput(const Output& output) {
+	this->output = output;
+}
+
+void Pipeline::setCandidateFilter(const CandidateFilter& candidateFilter) {
+	this->candidateFilter = candidateFilter;
+}
+
+void Pipeline::setEpipolarMetric(EpipolarMetric epipolarMetric) {
+	this->epipolarMetric = epipolarMetric;
+}
+
+void Pipeline::setPAFCompression(float threshold, bool isHalf) {
+	PAFThreshold = threshold;
+	isHalfPAF = isHalf;
+}
+
+void Pipeline::start() {
+	finish();
+	
+	affinityQueue.reopen();
+	associationQueue.reopen();
+	refinementQueue.reopen();
+	outputQueue.reopen();
+	stageTimes.assign(4, 0);
+	droppedCandidateNum = 0;
+	
+	stages.emplace_back(&Pipeline::run, this, 0, std::ref(affinityQueue), &associationQueue,
+		[this](PipelineFrame& frame) -> void {
+			droppedCandidateNum += candidateFilter.apply(frame.multiview);
+			if (PAFThreshold > 0) frame.multiview.compressPAFs(PAFThreshold, isHalfPAF);
+			if (!frame.multiview.hasEpipolarDistances(epipolarMetric)) {
+				frame.multiview.computeEpipolarDistances(epipolarMetric);
+			}
+		});
+	
+	/* QuickPose keeps search state, so association stays on one thread */
+	stages.emplace_back(&Pipeline::run, this, 1, std::ref(associationQueue), &refinementQueue,
+		[this](PipelineFrame& frame) -> void {
+			frame.multiPersonPose = quickpose.compute(frame.multiview);
+		});
+	
+	stages.emplace_back(&Pipeline::run, this, 2, std::ref(refinementQueue), &outputQueue,
+		[this](PipelineFrame& frame) -> void {
+			if (postProcess) postProcess(frame.multiPersonPose);
+		});
+	
+	stages.emplace_back(&Pipeline::run, this, 3, std::ref(outputQueue), nullptr,
+		[this](PipelineFrame& frame) -> void {
+			if (output) output(std::move(frame));
+		});
+}
+
+bool Pipeline::submit(PipelineFrame&& frame) {
+	return affinityQueue.push(std::move(frame));
+}
+
+bool Pipeline::trySubmit(PipelineFrame&& frame) {
+	return affinityQueue.tryPush(std::move(frame));
+}
+
+void Pipeline::finish() {
+	affinityQueue.close();
+	for (auto& stage : stages) {
+		stage.join();
+	}
+	stages.clear();
+}
+
+std::vector<double> Pipeline::getStageTimes() const {
+	return stageTimes;
+}
+
+size_t Pipeline::getDroppedCandidateNum() const {
+	return droppedCandidateNum;
+}
+
+void Pipeline::run(int stage, BoundedQueue<PipelineFrame>& input, BoundedQueue<PipelineFrame>* next,
+				   const std::function<void(PipelineFrame&)>& process) {
+	PipelineFrame frame;
+	while (input.pop(frame)) {
+		auto begin = std::chrono::steady_clock::now();
+		process(frame);
+		stageTimes[stage] += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		if (next && !next->push(std::move(frame))) break;
+	}
+	
+	/* closing cascades down the stages once this one is drained */
+	if (next) next->close();
+}
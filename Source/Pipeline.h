@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "QuickPose.h"
+#include "CandidateFilter.h"
+#include "BoundedQueue.h"
+
+#include <functional>
+#include <thread>
+
+class PipelineFrame {
+public:
+	int index = 0;
+	
+	MultiView multiview;
+	
+	MultiPersonPose multiPersonPose;
+	
+	explicit PipelineFrame() = default;
+	
+	explicit PipelineFrame(int index, MultiView multiview);
+};
+
+/**
+ * Runs the reconstruction as four stages on their own threads: affinity
+ * precompute, association, post-correction and output. Stages are joined by
+ * bounded queues, so frame N+1 is prepared while frame N is associated.
+ */
+class Pipeline {
+public:
+	using PostProcess = std::function<void(MultiPersonPose&)>;
+	
+	using Output = std::function<void(PipelineFrame&&)>;
+	
+	explicit Pipeline(QuickPose& quickpose, size_t queueCapacity = 4);
+	
+	~Pipeline();
+	
+	void setPostProcess(const PostProcess& postProcess);
+	
+	void setOutput(const Output& output);
+	
+	/* applied in the affinity stage, before the epipolar distances of frames that do not carry them yet */
+	void setCandidateFilter(const CandidateFilter& candidateFilter);
+	
+	/* the QuickPose epipolar threshold has to be in the metric's units */
+	void setEpipolarMetric(EpipolarMetric epipolarMetric);
+	
+	/* frames keep only PAFs at or above threshold after filtering, 0 keeps them dense */
+	void setPAFCompression(float threshold, bool isHalf);
+	
+	void start();
+	
+	/* blocks while the first stage is full */
+	bool submit(PipelineFrame&& frame);
+	
+	bool trySubmit(PipelineFrame&& frame);
+	
+	/* lets every submitted frame reach the output, then joins the stages */
+	void finish();
+	
+	/* busy seconds of each stage, read after finish */
+	std::vector<double> getStageTimes() const;
+	
+	/* candidates dropped by the filter, read after finish */
+	size_t getDroppedCandidateNum() const;
+	
+private:
+	QuickPose& quickpose;
+	
+	PostProcess postProcess;
+	
+	Output output;
+	
+	CandidateFilter candidateFilter;
+	
+	EpipolarMetric epipolarMetric = EpipolarMetric::RAY;
+	
+	float PAFThreshold = 0;
+	
+	bool isHalfPAF = false;
+	
+	size_t droppedCandidateNum = 0;
+	
+	BoundedQueue<PipelineFrame> affinityQueue;
+	
+	BoundedQueue<PipelineFrame> associationQueue;
+	
+	BoundedQueue<PipelineFrame> refinementQueue;
+	
+	BoundedQueue<PipelineFrame> outputQueue;
+	
+	std::vector<std::thread> stages;
+	
+	std::vector<double> stageTimes;
+	
+	void run(int stage, BoundedQueue<PipelineFrame>& input, BoundedQueue<PipelineFrame>* next,
+			 const std::function<void(PipelineFrame&)>& process);
+};
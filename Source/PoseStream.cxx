@@ -0,0 +1,265 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "PoseStream.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+constexpr unsigned POSE_STREAM_MAGIC = 0x53504d4d;
+constexpr unsigned POSE_STREAM_VERSION = 1;
+
+/* the slot sequence is padded so records stay 8-byte aligned */
+constexpr size_t SEQUENCE_SIZE = 8;
+constexpr size_t HEADER_SIZE = (sizeof(PoseStreamHeader) + 63) / 64 * 64;
+
+size_t PoseRecord::getPersonSize(int typeNum) {
+	return offsetof(Person, jointPos) + (typeNum * 3 * sizeof(float) + 7) / 8 * 8;
+}
+
+size_t PoseRecord::getRecordSize(int typeNum, int maxPersonNum) {
+	return sizeof(Header) + getPersonSize(typeNum) * maxPersonNum;
+}
+
+size_t PoseRecord::encode(const MultiPersonPose& multiPersonPose, unsigned long long frame,
+						  unsigned long long timestamp, int typeNum, int maxPersonNum, char* data) {
+	Header header;
+	header.frame = frame;
+	header.timestamp = timestamp;
+	header.personNum = static_cast<unsigned>(std::min(static_cast<int>(multiPersonPose.size()), maxPersonNum));
+	header.typeNum = static_cast<unsigned>(typeNum);
+	memcpy(data, &header, sizeof(Header));
+	
+	size_t personSize = getPersonSize(typeNum);
+	char* personData = data + sizeof(Header);
+	for (unsigned i = 0; i < header.personNum; ++i) {
+		auto& pose = multiPersonPose[i];
+		auto* person = reinterpret_cast<Person*>(personData);
+		person->ID = pose.ID;
+		person->reserved = 0;
+		person->jointMask = 0;
+		float* jointPos = person->jointPos;
+		for (int type = 0; type < typeNum; ++type) {
+			bool hasJoint = type < Pose::JOINT_NUM && pose.hasJoint(type);
+			if (hasJoint) person->jointMask |= 1ull << type;
+			Ink::Vec3 pos = hasJoint ? pose.jointPos[type] : Ink::Vec3();
+			jointPos[type * 3 + 0] = pos.x;
+			jointPos[type * 3 + 1] = pos.y;
+			jointPos[type * 3 + 2] = pos.z;
+		}
+		personData += personSize;
+	}
+	return personData - data;
+}
+
+void PoseRecord::decode(const char* data, MultiPersonPose& multiPersonPose) {
+	Header header;
+	memcpy(&header, data, sizeof(Header));
+	
+	int typeNum = std::min(static_cast<int>(header.typeNum), Pose::JOINT_NUM);
+	multiPersonPose.resize(header.personNum);
+	for (unsigned i = 0; i < header.personNum; ++i) {
+		auto& pose = multiPersonPose[i];
+		auto* person = getPerson(data, i);
+		pose.ID = person->ID;
+		pose.clearJoints();
+		const float* jointPos = person->jointPos;
+		for (int type = 0; type < typeNum; ++type) {
+			if (!((person->jointMask >> type) & 1)) continue;
+			pose.setJoint(type, {jointPos[type * 3 + 0], jointPos[type * 3 + 1], jointPos[type * 3 + 2]});
+		}
+	}
+}
+
+const PoseRecord::Person* PoseRecord::getPerson(const char* data, int index) {
+	unsigned typeNum = 0;
+	memcpy(&typeNum, data + offsetof(Header, typeNum), sizeof(unsigned));
+	return reinterpret_cast<const Person*>(data + sizeof(Header) + getPersonSize(typeNum) * index);
+}
+
+PoseStreamPublisher::~PoseStreamPublisher() {
+	close();
+}
+
+bool PoseStreamPublisher::open(const std::string& name, int typeNum, int maxPersonNum, int slotNum) {
+	close();
+	
+	if (typeNum > PoseRecord::MAX_TYPE_NUM) {
+		std::cerr << "PoseStreamPublisher Error: Too many joint types\n";
+		return false;
+	}
+	
+	size_t slotSize = SEQUENCE_SIZE + PoseRecord::getRecordSize(typeNum, maxPersonNum);
+	slotSize = (slotSize + 63) / 64 * 64;
+	size_t streamSize = HEADER_SIZE + slotSize * slotNum;
+	
+	int descriptor = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (descriptor == -1 || ftruncate(descriptor, static_cast<off_t>(streamSize)) == -1) {
+		std::cerr << "PoseStreamPublisher Error: Failed to create shared memory " << name << "\n";
+		if (descriptor != -1) ::close(descriptor);
+		return false;
+	}
+	address = mmap(nullptr, streamSize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	::close(descriptor);
+	if (address == MAP_FAILED) {
+		std::cerr << "PoseStreamPublisher Error: Failed to map shared memory " << name << "\n";
+		address = nullptr;
+		return false;
+	}
+	this->name = name;
+	size = streamSize;
+	memset(address, 0, streamSize);
+	
+	auto* header = new (address) PoseStreamHeader();
+	header->version = POSE_STREAM_VERSION;
+	header->slotNum = static_cast<unsigned>(slotNum);
+	header->typeNum = static_cast<unsigned>(typeNum);
+	header->maxPersonNum = static_cast<unsigned>(maxPersonNum);
+	header->slotSize = static_cast<unsigned>(slotSize);
+	header->writeIndex.store(0, std::memory_order_relaxed);
+	for (int slot = 0; slot < slotNum; ++slot) {
+		new (static_cast<char*>(address) + HEADER_SIZE + slotSize * slot) std::atomic<unsigned long long>(0);
+	}
+	
+	/* readers check the magic last, so they never see a half-initialized stream */
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = POSE_STREAM_MAGIC;
+	return true;
+}
+
+void PoseStreamPublisher::close() {
+	if (address == nullptr) return;
+	munmap(address, size);
+	shm_unlink(name.c_str());
+	address = nullptr;
+	size = 0;
+}
+
+void PoseStreamPublisher::publish(const MultiPersonPose& multiPersonPose, unsigned long long frame,
+								  unsigned long long timestamp) {
+	if (address == nullptr) return;
+	
+	auto* header = static_cast<PoseStreamHeader*>(address);
+	unsigned long long index = header->writeIndex.load(std::memory_order_relaxed);
+	char* slot = static_cast<char*>(address) + HEADER_SIZE + header->slotSize * (index % header->slotNum);
+	auto* sequence = reinterpret_cast<std::atomic<unsigned long long>*>(slot);
+	
+	sequence->store(index * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	PoseRecord::encode(multiPersonPose, frame, timestamp, static_cast<int>(header->typeNum),
+					   static_cast<int>(header->maxPersonNum), slot + SEQUENCE_SIZE);
+	sequence->store(index * 2 + 2, std::memory_order_release);
+	header->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+PoseStreamReader::~PoseStreamReader() {
+	close();
+}
+
+bool PoseStreamReader::open(const std::string& name) {
+	close();
+	
+	int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+	if (descriptor == -1) return false;
+	
+	PoseStreamHeader header;
+	void* headerAddress = mmap(nullptr, HEADER_SIZE, PROT_READ, MAP_SHARED, descriptor, 0);
+	if (headerAddress == MAP_FAILED) {
+		::close(descriptor);
+		return false;
+	}
+	memcpy(static_cast<void*>(&header), headerAddress, offsetof(PoseStreamHeader, writeIndex));
+	munmap(headerAddress, HEADER_SIZE);
+	
+	if (header.magic != POSE_STREAM_MAGIC || header.version != POSE_STREAM_VERSION) {
+		::close(descriptor);
+		return false;
+	}
+	
+	size_t streamSize = HEADER_SIZE + static_cast<size_t>(header.slotSize) * header.slotNum;
+	void* streamAddress = mmap(nullptr, streamSize, PROT_READ, MAP_SHARED, descriptor, 0);
+	::close(descriptor);
+	if (streamAddress == MAP_FAILED) return false;
+	
+	address = streamAddress;
+	size = streamSize;
+	return true;
+}
+
+void PoseStreamReader::close() {
+	if (address == nullptr) return;
+	munmap(const_cast<void*>(address), size);
+	address = nullptr;
+	size = 0;
+}
+
+unsigned long long PoseStreamReader::getWriteIndex() const {
+	if (address == nullptr) return 0;
+	return static_cast<const PoseStreamHeader*>(address)->writeIndex.load(std::memory_order_acquire);
+}
+
+const char* PoseStreamReader::beginRead(unsigned long long index) const {
+	if (address == nullptr) return nullptr;
+	if (getSequence(index)->load(std::memory_order_acquire) != index * 2 + 2) return nullptr;
+	return reinterpret_cast<const char*>(getSequence(index)) + SEQUENCE_SIZE;
+}
+
+bool PoseStreamReader::endRead(unsigned long long index) const {
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return getSequence(index)->load(std::memory_order_relaxed) == index * 2 + 2;
+}
+
+bool PoseStreamReader::readLatest(MultiPersonPose& multiPersonPose, unsigned long long& frame) const {
+	/* the writer may lap a slow reader, so retry on the then newest record */
+	for (int attempt = 0; attempt < 4; ++attempt) {
+		unsigned long long writeIndex = getWriteIndex();
+		if (writeIndex == 0) return false;
+		
+		unsigned long long index = writeIndex - 1;
+		const char* record = beginRead(index);
+		if (record == nullptr) continue;
+		
+		/* a torn header must not drive the decoding */
+		auto* streamHeader = static_cast<const PoseStreamHeader*>(address);
+		PoseRecord::Header header;
+		memcpy(&header, record, sizeof(PoseRecord::Header));
+		if (header.personNum > streamHeader->maxPersonNum || header.typeNum != streamHeader->typeNum) continue;
+		PoseRecord::decode(record, multiPersonPose);
+		if (endRead(index)) {
+			frame = header.frame;
+			return true;
+		}
+	}
+	return false;
+}
+
+const std::atomic<unsigned long long>* PoseStreamReader::getSequence(unsigned long long index) const {
+	auto* header = static_cast<const PoseStreamHeader*>(address);
+	const char* slot = static_cast<const char*>(address) + HEADER_SIZE + header->slotSize * (index % header->slotNum);
+	return reinterpret_cast<const std::atomic<unsigned long long>*>(slot);
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Views.h"
+
+#include <atomic>
+
+/**
+ * Fixed-layout binary record of one frame. After the header, every person
+ * takes the same size: ID, a joint bitmask and typeNum packed xyz floats,
+ * so a record of maxPersonNum persons has a size known in advance.
+ */
+class PoseRecord {
+public:
+	class Header {
+	public:
+		unsigned long long frame;
+		unsigned long long timestamp;
+		unsigned personNum;
+		unsigned typeNum;
+	};
+	
+	class Person {
+	public:
+		int ID;
+		unsigned reserved;
+		unsigned long long jointMask;
+		float jointPos[1];
+	};
+	
+	static constexpr int MAX_TYPE_NUM = 64;
+	
+	static size_t getPersonSize(int typeNum);
+	
+	static size_t getRecordSize(int typeNum, int maxPersonNum);
+	
+	/* returns the number of bytes written, persons beyond maxPersonNum are dropped */
+	static size_t encode(const MultiPersonPose& multiPersonPose, unsigned long long frame,
+						 unsigned long long timestamp, int typeNum, int maxPersonNum, char* data);
+	
+	static void decode(const char* data, MultiPersonPose& multiPersonPose);
+	
+	static const Person* getPerson(const char* data, int index);
+};
+
+/**
+ * Layout of the shared memory: a header followed by slotNum slots. Each slot
+ * starts with a seqlock sequence that is 2 * index + 1 while the record of
+ * that index is written and 2 * index + 2 once it is complete.
+ */
+class PoseStreamHeader {
+public:
+	unsigned magic;
+	unsigned version;
+	unsigned slotNum;
+	unsigned typeNum;
+	unsigned maxPersonNum;
+	unsigned slotSize;
+	std::atomic<unsigned long long> writeIndex;
+};
+
+class PoseStreamPublisher {
+public:
+	explicit PoseStreamPublisher() = default;
+	
+	~PoseStreamPublisher();
+	
+	PoseStreamPublisher(const PoseStreamPublisher&) = delete;
+	
+	PoseStreamPublisher& operator=(const PoseStreamPublisher&) = delete;
+	
+	bool open(const std::string& name, int typeNum, int maxPersonNum = 16, int slotNum = 64);
+	
+	void close();
+	
+	/* single writer, never blocks on readers */
+	void publish(const MultiPersonPose& multiPersonPose, unsigned long long frame, unsigned long long timestamp);
+	
+private:
+	std::string name;
+	
+	void* address = nullptr;
+	
+	size_t size = 0;
+};
+
+class PoseStreamReader {
+public:
+	explicit PoseStreamReader() = default;
+	
+	~PoseStreamReader();
+	
+	PoseStreamReader(const PoseStreamReader&) = delete;
+	
+	PoseStreamReader& operator=(const PoseStreamReader&) = delete;
+	
+	bool open(const std::string& name);
+	
+	void close();
+	
+	/* index of the next record to be published */
+	unsigned long long getWriteIndex() const;
+	
+	/*
+	 * Zero-copy access: the record is read in place between beginRead and
+	 * endRead, and must be discarded if endRead returns false.
+	 */
+	const char* beginRead(unsigned long long index) const;
+	
+	bool endRead(unsigned long long index) const;
+	
+	/* copies the newest complete record, returns false if there is none */
+	bool readLatest(MultiPersonPose& multiPersonPose, unsigned long long& frame) const;
+	
+private:
+	const void* address = nullptr;
+	
+	size_t size = 0;
+	
+	const std::atomic<unsigned long long>* getSequence(unsigned long long index) const;
+};
@@ -23,8 +23,13 @@
 #include "QuickPose.h"
 
 #include "MathUtils.h"
+#include "Parallel.h"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <tuple>
+#include <unordered_map>
 
 #include <opencv2/opencv.hpp>
 
@@ -57,26 +62,42 @@
 //}
 
 
-constexpr float EPS = 0.0001f;
 constexpr int NO_CHOICE = -1;
 
 constexpr unsigned int I16 = 1 << 16;
 
-QCluster::QCluster(int viewNum, int typeNum) {
+QCluster::QCluster(int viewNum, int typeNum) : typeNum(typeNum) {
 	score = 0;
-	choices.resize(viewNum);
-	for (auto& choicesPerView : choices) {
-		choicesPerView.resize(typeNum, NO_CHOICE);
-	}
+	choices.resize(viewNum * typeNum, NO_CHOICE);
 	worldPos.resize(typeNum);
 }
 
 int QCluster::getJoint(int view, int type) const {
-	return choices[view][type];
+	return choices[view * typeNum + type];
 }
 
 void QCluster::setJoint(int view, int type, int choice) {
-	choices[view][type] = choice;
+	choices[view * typeNum + type] = choice;
+}
+
+uint64_t QCluster::getFingerprint() const {
+	uint64_t fingerprint = 0xcbf29ce484222325ULL;
+	for (int choice : choices) {
+		fingerprint = (fingerprint ^ static_cast<uint64_t>(choice + 1)) * 0x100000001b3ULL;
+	}
+	uint64_t mainViewMask = 0;
+	for (int type = 0; type < typeNum; ++type) {
+		mainViewMask |= static_cast<uint64_t>(getJoint(mainView, type) != NO_CHOICE) << (type & 63);
+	}
+	return (fingerprint ^ mainViewMask) * 0x100000001b3ULL;
+}
+
+bool QCluster::hasSameAssignment(const QCluster& cluster) const {
+	if (choices != cluster.choices) return false;
+	for (int type = 0; type < typeNum; ++type) {
+		if ((getJoint(mainView, type) == NO_CHOICE) != (cluster.getJoint(cluster.mainView, type) == NO_CHOICE)) return false;
+	}
+	return true;
 }
 
 void QuickPose::initBody25() {
@@ -88,89 +109,627 @@ void QuickPose::initBody25() {
 	parents = {
 		1, 8, 1, 2, 3, 1, 5, 6, -1, 8, 9, 10, 8, 12, 13, 0, 0, 2, 5, 14, 19, 14, 11, 22, 11,
 	};
-	historyScores.resize(25);
+	boneConstraints.resize(static_cast<int>(parents.size()));
+	setJointOrders({
+//		{8, 1, 2, 3, 4, 5, 6, 7, 0},
+		{8, 1, 2, 3, 4},
+		{8, 1, 5, 6, 7},
+		{8, 1, 0},
+		{8, 9, 10, 11},
+		{8, 12, 13, 14},
+		{8, 1, 2, 17},
+		{8, 1, 5, 18},
+	});
+}
+
+void QuickPose::setJointOrders(const std::vector<std::vector<int> >& jointOrders) {
+	this->jointOrders = jointOrders;
+	buildJointTree();
+}
+
+void QuickPose::setTorsoJoints(const std::vector<int>& jointTypes) {
+	torsoJoints = jointTypes;
+	buildJointTree();
+}
+
+void QuickPose::buildJointTree() {
+	jointTree.clear();
+	jointTreeRootNum = 0;
+	attachedJoints.clear();
+	
+	/* with torso joints, each chain is searched up to its first limb joint and the rest is attached */
+	std::vector<std::vector<int> > jointOrders = this->jointOrders;
+	if (!torsoJoints.empty()) {
+		for (auto& jointOrder : jointOrders) {
+			auto isTorso = [&](int type) -> bool {
+				return std::find(torsoJoints.begin(), torsoJoints.end(), type) != torsoJoints.end();
+			};
+			auto limb = std::find_if_not(jointOrder.begin(), jointOrder.end(), isTorso);
+			for (auto type = limb; type != jointOrder.end(); ++type) {
+				if (std::find(attachedJoints.begin(), attachedJoints.end(), *type) == attachedJoints.end()) {
+					attachedJoints.emplace_back(*type);
+				}
+			}
+			jointOrder.erase(limb, jointOrder.end());
+		}
+	}
+	
+	/* roots are inserted first, so they keep the first indices */
+	for (auto& jointOrder : jointOrders) {
+		if (jointOrder.empty()) continue;
+		bool isNewRoot = true;
+		for (int root = 0; root < jointTreeRootNum; ++root) {
+			isNewRoot &= jointTree[root].type != jointOrder[0];
+		}
+		if (!isNewRoot) continue;
+		jointTree.emplace_back();
+		jointTree.back().type = jointOrder[0];
+		++jointTreeRootNum;
+	}
+	
+	for (auto& jointOrder : jointOrders) {
+		if (jointOrder.empty()) continue;
+		int node = 0;
+		while (jointTree[node].type != jointOrder[0]) ++node;
+		for (int depth = 1; depth < jointOrder.size(); ++depth) {
+			int next = -1;
+			for (int child : jointTree[node].children) {
+				if (jointTree[child].type == jointOrder[depth]) next = child;
+			}
+			if (next == -1) {
+				next = static_cast<int>(jointTree.size());
+				jointTree.emplace_back();
+				jointTree.back().type = jointOrder[depth];
+				jointTree.back().depth = depth;
+				jointTree[node].children.emplace_back(next);
+			}
+			node = next;
+		}
+		jointTree[node].isChainEnd = true;
+	}
 }
 
 MultiPersonPose QuickPose::compute(const MultiView& multiview) {
-	viewNum = static_cast<int>(multiview.views.size());
-	typeNum = static_cast<int>(multiview.views[0].joints.size());
+	if (viewNum != multiview.getViewNum()) {
+		viewNum = multiview.getViewNum();
+		viewOrders.assign(viewNum, std::vector<int>(viewNum));
+		for (int mainView = 0; mainView < viewNum; ++mainView) {
+			for (int viewI = 0; viewI < viewNum; ++viewI) {
+				viewOrders[mainView][viewI] = (mainView + viewI) % viewNum;
+			}
+		}
+	}
+	typeNum = multiview.getTypeNum();
 	
-	rays.resize(viewNum);
-	confs.resize(viewNum);
+	computeComponents(multiview);
+	if (seedVoxelSize > 0) computeSeeds(multiview);
 	
-	clusterNum = 0;
-	preservedClusters.resize(maxClusterNum);
+	int componentNum = static_cast<int>(rootComponents.size());
+	/* one search per worker, thread indices come from a pool of exactly searchNum threads */
+	int searchNum = threadNum > 0 ? threadNum : Parallel::getThreadNum();
+	searches.resize(searchNum);
+	for (int thread = 0; thread < searchNum; ++thread) {
+		auto& search = searches[thread];
+		search.thread = thread;
+		search.pool = nullptr;
+		search.clusterNum = 0;
+		search.clusterSlots.assign(search.clusterSlots.empty() ? 1024 : search.clusterSlots.size(), 0);
+		search.cluster = QCluster(viewNum, typeNum);
+		search.historyScores.resize(typeNum);
+		search.origins.resize(viewNum);
+		search.directions.resize(viewNum);
+	}
 	
-	QCluster cluster(viewNum, typeNum);
+	if (searchNum == 1 || componentNum == 0) {
+		QTask task;
+		for (int componentI = 0; componentI < componentNum; ++componentI) {
+			task.component = rootComponents[componentI];
+			run(multiview, searches[0], task);
+		}
+	} else {
+		/* the workers persist across frames and sleep while there is nothing to search */
+		if (!pool || pool->getThreadNum() != searchNum) {
+			pool.reset();
+			pool = std::make_unique<WorkStealingPool<QTask> >(searchNum);
+		}
+		
+		/* components start round-robin, large subtrees are split while any thread is idle */
+		for (int componentI = 0; componentI < componentNum; ++componentI) {
+			QTask task;
+			task.component = rootComponents[componentI];
+			pool->push(componentI % searchNum, std::move(task));
+		}
+		for (auto& search : searches) search.pool = pool.get();
+		pool->run([&](QTask& task, int thread) -> void {
+			run(multiview, searches[thread], task);
+		});
+		for (auto& search : searches) search.pool = nullptr;
+		
+		/* a component may be searched by several threads, copies keep the best score */
+		auto& mergedSearch = searches[0];
+		for (int thread = 1; thread < searchNum; ++thread) {
+			auto& search = searches[thread];
+			for (int clusterI = 0; clusterI < search.clusterNum; ++clusterI) {
+				preserve(mergedSearch, search.clusters[clusterI], search.fingerprints[clusterI]);
+			}
+		}
+	}
+	
+	preservedClusters.clear();
+	auto& mergedSearch = searches[0];
+	for (int clusterI = 0; clusterI < mergedSearch.clusterNum; ++clusterI) {
+		preservedClusters.emplace_back(&mergedSearch.clusters[clusterI]);
+	}
 	
-	std::vector<std::vector<int> > viewOrders = {
-		{0, 1, 2, 3, 4},
-		{1, 2, 3, 4, 0},
-		{2, 3, 4, 0, 1},
-		{3, 4, 0, 1, 2},
-		{4, 0, 1, 2, 3},
+	/* best first, ties broken by the assignment, so neither order nor cap depends on the threads */
+	auto getFingerprint = [&](const QCluster* cluster) -> uint64_t {
+		return mergedSearch.fingerprints[cluster - mergedSearch.clusters.data()];
 	};
+	std::sort(preservedClusters.begin(), preservedClusters.end(),
+			  [&](const QCluster* cluster1, const QCluster* cluster2) -> bool {
+		if (cluster1->score != cluster2->score) return cluster1->score > cluster2->score;
+		uint64_t fingerprint1 = getFingerprint(cluster1);
+		uint64_t fingerprint2 = getFingerprint(cluster2);
+		if (fingerprint1 != fingerprint2) return fingerprint1 < fingerprint2;
+		return cluster1->choices < cluster2->choices;
+	});
+	if (static_cast<int>(preservedClusters.size()) > maxClusterNum) preservedClusters.resize(maxClusterNum);
+	count += static_cast<int>(preservedClusters.size());
 	
-	std::vector<std::vector<int> > jointOrders = {
-//		{8, 1, 2, 3, 4, 5, 6, 7, 0},
-		{8, 1, 2, 3, 4},
-		{8, 1, 5, 6, 7},
-		{8, 1, 0},
-		{8, 9, 10, 11},
-		{8, 12, 13, 14},
-		{8, 1, 2, 17},
-		{8, 1, 5, 18},
+	MultiPersonPose multiPersonPose = postProcessing(multiview);
+	if (!attachedJoints.empty()) attachJoints(multiview, multiPersonPose);
+	return multiPersonPose;
+}
+
+void QuickPose::computeComponents(const MultiView& multiview) {
+	int totalJointNum = multiview.getTotalJointNum();
+	components.resize(totalJointNum);
+	for (int joint = 0; joint < totalJointNum; ++joint) components[joint] = joint;
+	
+	auto find = [&](int joint) -> int {
+		while (components[joint] != joint) {
+			components[joint] = components[components[joint]];
+			joint = components[joint];
+		}
+		return joint;
+	};
+	auto unite = [&](int jointA, int jointB) -> void {
+		jointA = find(jointA);
+		jointB = find(jointB);
+		if (jointA != jointB) components[std::max(jointA, jointB)] = std::min(jointA, jointB);
 	};
 	
-	for (auto& curViewOrder : viewOrders) {
-		viewOrder = curViewOrder;
-		cluster.mainView = viewOrder[0];
-		for (auto& curJointOrder : jointOrders) {
-			jointOrder = curJointOrder;
-			compute(multiview, cluster, 0, 0);
+	/* the same thresholds as the search, so a cluster never spans two components */
+	for (int type = 0; type < typeNum; ++type) {
+		int parentType = parents[type];
+		if (parentType == -1) continue;
+		for (int view = 0; view < viewNum; ++view) {
+			int parentNum = multiview.getJointNum(view, parentType);
+			int jointNum = multiview.getJointNum(view, type);
+			for (int parentChoice = 0; parentChoice < parentNum; ++parentChoice) {
+				if (multiview.isPAFCompressed()) {
+					PAFRow row = multiview.getPAFRow(view, parentType, parentChoice, type);
+					for (int index = 0; index < row.size; ++index) {
+						if (row.getValue(index) < minAffinity) continue;
+						unite(multiview.getJointIndex(view, parentType, parentChoice), multiview.getJointIndex(view, type, row.choices[index]));
+					}
+					continue;
+				}
+				for (int choice = 0; choice < jointNum; ++choice) {
+					if (multiview.getPAF(view, parentType, parentChoice, type, choice) < minAffinity) continue;
+					unite(multiview.getJointIndex(view, parentType, parentChoice), multiview.getJointIndex(view, type, choice));
+				}
+			}
+		}
+	}
+	
+	for (int type = 0; type < typeNum; ++type) {
+		for (int viewA = 0; viewA < viewNum; ++viewA) {
+			for (int viewB = viewA + 1; viewB < viewNum; ++viewB) {
+				int jointNumA = multiview.getJointNum(viewA, type);
+				int jointNumB = multiview.getJointNum(viewB, type);
+				for (int choiceA = 0; choiceA < jointNumA; ++choiceA) {
+					for (int choiceB = 0; choiceB < jointNumB; ++choiceB) {
+						float distance = multiview.getEpipolarDistance(type, viewA, choiceA, viewB, choiceB);
+						if (1.f - distance / maxEpipolarDistance < minAffinity) continue;
+						unite(multiview.getJointIndex(viewA, type, choiceA), multiview.getJointIndex(viewB, type, choiceB));
+					}
+				}
+			}
+		}
+	}
+	
+	for (int joint = 0; joint < totalJointNum; ++joint) components[joint] = find(joint);
+	
+	rootComponents.clear();
+	for (int view = 0; view < viewNum; ++view) {
+		for (int choice = 0; choice < multiview.getJointNum(view, rootJointType); ++choice) {
+			int component = components[multiview.getJointIndex(view, rootJointType, choice)];
+			if (std::find(rootComponents.begin(), rootComponents.end(), component) == rootComponents.end()) {
+				rootComponents.emplace_back(component);
+			}
+		}
+	}
+	std::sort(rootComponents.begin(), rootComponents.end());
+}
+
+void QuickPose::computeSeeds(const MultiView& multiview) {
+	seeds.clear();
+	rootPairs.clear();
+	
+	/* voxel coordinates packed 21 bits each */
+	auto getVoxelKey = [](long long x, long long y, long long z) -> long long {
+		return ((x & 0x1fffff) << 42) | ((y & 0x1fffff) << 21) | (z & 0x1fffff);
+	};
+	auto getVoxel = [&](long long key, long long* voxel) -> void {
+		for (int axis = 0; axis < 3; ++axis) {
+			long long coordinate = (key >> (42 - axis * 21)) & 0x1fffff;
+			
+			/* sign extend the packed coordinate */
+			voxel[axis] = coordinate >= 0x100000 ? coordinate - 0x200000 : coordinate;
+		}
+	};
+	
+	/* every epipolar-consistent root pair votes for the voxel of its triangulation */
+	Ink::Vec3 origins[2];
+	Ink::Vec3 directions[2];
+	for (int viewA = 0; viewA < viewNum; ++viewA) {
+		for (int viewB = viewA + 1; viewB < viewNum; ++viewB) {
+			origins[0] = multiview.getCamera(viewA).pos;
+			origins[1] = multiview.getCamera(viewB).pos;
+			for (int choiceA = 0; choiceA < multiview.getJointNum(viewA, rootJointType); ++choiceA) {
+				for (int choiceB = 0; choiceB < multiview.getJointNum(viewB, rootJointType); ++choiceB) {
+					float distance = multiview.getEpipolarDistance(rootJointType, viewA, choiceA, viewB, choiceB);
+					float epipolar = 1.f - distance / maxEpipolarDistance;
+					if (epipolar < minAffinity) continue;
+					directions[0] = multiview.getDirection(viewA, rootJointType, choiceA);
+					directions[1] = multiview.getDirection(viewB, rootJointType, choiceB);
+					QRootPair pair;
+					pair.viewA = viewA;
+					pair.choiceA = choiceA;
+					pair.viewB = viewB;
+					pair.choiceB = choiceB;
+					pair.score = epipolar;
+					pair.pos = MathUtils::multiRayIntersect(origins, directions, 2);
+					pair.voxel = getVoxelKey(static_cast<long long>(std::floor(pair.pos.x / seedVoxelSize)),
+											 static_cast<long long>(std::floor(pair.pos.y / seedVoxelSize)),
+											 static_cast<long long>(std::floor(pair.pos.z / seedVoxelSize)));
+					rootPairs.emplace_back(pair);
+				}
+			}
+		}
+	}
+	
+	/* pairs of a voxel are adjacent, the most consistent first */
+	std::sort(rootPairs.begin(), rootPairs.end(), [](const QRootPair& pair1, const QRootPair& pair2) -> bool {
+		if (pair1.voxel != pair2.voxel) return pair1.voxel < pair2.voxel;
+		if (pair1.score != pair2.score) return pair1.score > pair2.score;
+		return std::tie(pair1.viewA, pair1.choiceA, pair1.viewB, pair1.choiceB) <
+			   std::tie(pair2.viewA, pair2.choiceA, pair2.viewB, pair2.choiceB);
+	});
+	std::unordered_map<long long, std::pair<int, int> > voxelPairs;
+	int pairNum = static_cast<int>(rootPairs.size());
+	for (int pairI = 0; pairI < pairNum; ++pairI) {
+		auto range = voxelPairs.try_emplace(rootPairs[pairI].voxel, pairI, pairI).first;
+		range->second.second = pairI + 1;
+	}
+	
+	/* a choice joins a proposal if it is its choice already, or agrees with every view it has */
+	auto isConsistent = [&](const QSeed& seed, int view, int choice) -> bool {
+		if (seed.choices[view] != NO_CHOICE) return seed.choices[view] == choice;
+		for (int otherView = 0; otherView < viewNum; ++otherView) {
+			if (seed.choices[otherView] == NO_CHOICE) continue;
+			float distance = multiview.getEpipolarDistance(rootJointType, otherView, seed.choices[otherView],
+														   view, choice);
+			if (1.f - distance / maxEpipolarDistance < minAffinity) return false;
+		}
+		return true;
+	};
+	
+	/* the pair belongs to the person of the proposal: it shares a detection and agrees with the rest */
+	auto isSupporting = [&](const QSeed& seed, const QRootPair& pair) -> bool {
+		bool isShared = seed.choices[pair.viewA] == pair.choiceA || seed.choices[pair.viewB] == pair.choiceB;
+		return isShared && isConsistent(seed, pair.viewA, pair.choiceA) && isConsistent(seed, pair.viewB, pair.choiceB);
+	};
+	
+	/**
+	 * 1. Proposals are built from the pairs of their own voxel only. People
+	 * whose roots share a voxel use different detections, so their pairs
+	 * start separate proposals instead of being mixed into one.
+	 */
+	std::vector<QSeed> proposals;
+	for (int begin = 0; begin < pairNum;) {
+		int end = voxelPairs[rootPairs[begin].voxel].second;
+		int firstProposal = static_cast<int>(proposals.size());
+		for (int pairI = begin; pairI < end; ++pairI) {
+			auto& pair = rootPairs[pairI];
+			QSeed* joined = nullptr;
+			for (int proposalI = firstProposal; proposalI < static_cast<int>(proposals.size()) && joined == nullptr; ++proposalI) {
+				if (isSupporting(proposals[proposalI], pair)) joined = &proposals[proposalI];
+			}
+			if (joined == nullptr) {
+				joined = &proposals.emplace_back();
+				joined->voxel = pair.voxel;
+				joined->choices.assign(viewNum, NO_CHOICE);
+			}
+			joined->choices[pair.viewA] = pair.choiceA;
+			joined->choices[pair.viewB] = pair.choiceB;
+		}
+		begin = end;
+	}
+	
+	/* 2. votes come from the pairs of the neighborhood that support the proposal */
+	int proposalNum = static_cast<int>(proposals.size());
+	std::vector<std::array<long long, 3> > proposalVoxels(proposalNum);
+	for (int proposalI = 0; proposalI < proposalNum; ++proposalI) {
+		auto& proposal = proposals[proposalI];
+		long long* voxel = proposalVoxels[proposalI].data();
+		getVoxel(proposal.voxel, voxel);
+		for (long long dx = -1; dx <= 1; ++dx) {
+			for (long long dy = -1; dy <= 1; ++dy) {
+				for (long long dz = -1; dz <= 1; ++dz) {
+					auto range = voxelPairs.find(getVoxelKey(voxel[0] + dx, voxel[1] + dy, voxel[2] + dz));
+					if (range == voxelPairs.end()) continue;
+					for (int pairI = range->second.first; pairI < range->second.second; ++pairI) {
+						proposal.voteNum += isSupporting(proposal, rootPairs[pairI]);
+					}
+				}
+			}
+		}
+	}
+	
+	/**
+	 * 3. From the strongest down, a proposal merges into a stronger
+	 * neighboring one that it shares a detection with and never contradicts.
+	 * Proposals with a different choice in some view are kept apart, whether
+	 * they are other people or wrong combinations of them, and left to the
+	 * search to tell apart with the whole body.
+	 */
+	auto isNeighbor = [&](int proposalI, int proposalJ) -> bool {
+		auto& voxelI = proposalVoxels[proposalI];
+		auto& voxelJ = proposalVoxels[proposalJ];
+		return std::abs(voxelI[0] - voxelJ[0]) <= 1 && std::abs(voxelI[1] - voxelJ[1]) <= 1 &&
+			   std::abs(voxelI[2] - voxelJ[2]) <= 1;
+	};
+	auto isCompatible = [&](const QSeed& seed, const QSeed& otherSeed) -> bool {
+		bool isShared = false;
+		for (int view = 0; view < viewNum; ++view) {
+			int choice = seed.choices[view];
+			int otherChoice = otherSeed.choices[view];
+			if (choice == NO_CHOICE || otherChoice == NO_CHOICE) continue;
+			if (choice != otherChoice) return false;
+			isShared = true;
+		}
+		return isShared;
+	};
+	std::vector<int> order(proposalNum);
+	for (int proposalI = 0; proposalI < proposalNum; ++proposalI) order[proposalI] = proposalI;
+	std::sort(order.begin(), order.end(), [&](int proposalI, int proposalJ) -> bool {
+		if (proposals[proposalI].voteNum != proposals[proposalJ].voteNum) {
+			return proposals[proposalI].voteNum > proposals[proposalJ].voteNum;
+		}
+		return proposalI < proposalJ;
+	});
+	std::vector<bool> isMerged(proposalNum, false);
+	std::vector<int> keptProposals;
+	for (int proposalI : order) {
+		auto& proposal = proposals[proposalI];
+		for (int proposalJ : keptProposals) {
+			auto& keptProposal = proposals[proposalJ];
+			if (!isNeighbor(proposalI, proposalJ) || !isCompatible(proposal, keptProposal)) continue;
+			for (int view = 0; view < viewNum; ++view) {
+				int choice = proposal.choices[view];
+				if (choice == NO_CHOICE || !isConsistent(keptProposal, view, choice)) continue;
+				keptProposal.choices[view] = choice;
+			}
+			isMerged[proposalI] = true;
+			break;
+		}
+		if (!isMerged[proposalI]) keptProposals.emplace_back(proposalI);
+	}
+	
+	for (int proposalI = 0; proposalI < proposalNum; ++proposalI) {
+		if (isMerged[proposalI]) continue;
+		auto& seed = proposals[proposalI];
+		if (seed.voteNum < minSeedVoteNum) continue;
+		
+		/* the views of a proposal agree pairwise, the seed starts with their epipolar score */
+		int firstView = -1;
+		for (int viewA = 0; viewA < viewNum; ++viewA) {
+			if (seed.choices[viewA] == NO_CHOICE) continue;
+			if (firstView == -1) firstView = viewA;
+			for (int viewB = viewA + 1; viewB < viewNum; ++viewB) {
+				if (seed.choices[viewB] == NO_CHOICE) continue;
+				float distance = multiview.getEpipolarDistance(rootJointType, viewA, seed.choices[viewA],
+															   viewB, seed.choices[viewB]);
+				seed.score += 1.f - distance / maxEpipolarDistance;
+			}
+		}
+		
+		seed.component = components[multiview.getJointIndex(firstView, rootJointType, seed.choices[firstView])];
+		bool isDuplicate = false;
+		for (auto& otherSeed : seeds) {
+			isDuplicate |= otherSeed.choices == seed.choices;
+		}
+		if (!isDuplicate) seeds.emplace_back(std::move(seed));
+	}
+}
+
+void QuickPose::run(const MultiView& multiview, QSearch& search, QTask& task) {
+	switch (viewNum) {
+		case 3: return run<3>(multiview, search, task);
+		case 4: return run<4>(multiview, search, task);
+		case 5: return run<5>(multiview, search, task);
+		case 6: return run<6>(multiview, search, task);
+		case 8: return run<8>(multiview, search, task);
+		default: return run<0>(multiview, search, task);
+	}
+}
+
+template <int V>
+void QuickPose::run(const MultiView& multiview, QSearch& search, QTask& task) {
+	if (task.node == -1) {
+		auto& cluster = search.cluster;
+		std::fill(cluster.choices.begin(), cluster.choices.end(), NO_CHOICE);
+		cluster.score = 0;
+		this->search<V>(multiview, search, task.component);
+		return;
+	}
+	
+	/* continue exactly where the splitting thread stopped */
+	search.component = task.component;
+	search.cluster = task.cluster;
+	search.viewOrder = task.viewOrder;
+	search.historyScores = task.historyScores;
+	compute<V>(multiview, search, task.viewI, task.node);
+}
+
+void QuickPose::split(QSearch& search, int viewI, int node) {
+	QTask task;
+	task.component = search.component;
+	task.viewI = viewI;
+	task.node = node;
+	task.cluster = search.cluster;
+	task.viewOrder = search.viewOrder;
+	task.historyScores = search.historyScores;
+	search.pool->push(search.thread, std::move(task));
+}
+
+template <int V>
+void QuickPose::search(const MultiView& multiview, QSearch& search, int component) {
+	search.component = component;
+	
+	if (seedVoxelSize > 0) {
+		auto& cluster = search.cluster;
+		for (auto& seed : seeds) {
+			if (seed.component != component) continue;
+			for (int view = 0; view < viewNum; ++view) {
+				cluster.setJoint(view, rootJointType, seed.choices[view]);
+			}
+			
+			/* the root is assigned, continue below it */
+			for (auto& curViewOrder : viewOrders) {
+				if (seed.choices[curViewOrder[0]] == NO_CHOICE) continue;
+				search.viewOrder = curViewOrder;
+				cluster.mainView = search.viewOrder[0];
+				for (int root = 0; root < jointTreeRootNum; ++root) {
+					if (jointTree[root].type != rootJointType) continue;
+					cluster.score = seed.score;
+					computeWorldPos<V>(multiview, search, rootJointType);
+					search.historyScores[0] = cluster.score;
+					expand<V>(multiview, search, root);
+				}
+			}
+			
+			for (int view = 0; view < viewNum; ++view) {
+				cluster.setJoint(view, rootJointType, NO_CHOICE);
+			}
+			cluster.score = 0;
 		}
 	}
 	
-	return postProcessing(multiview);
+	/* chains starting at any other joint have no seeds, they are searched exhaustively */
+	for (auto& curViewOrder : viewOrders) {
+		search.viewOrder = curViewOrder;
+		search.cluster.mainView = search.viewOrder[0];
+		for (int root = 0; root < jointTreeRootNum; ++root) {
+			if (seedVoxelSize > 0 && jointTree[root].type == rootJointType) continue;
+			compute<V>(multiview, search, 0, root);
+		}
+	}
 }
 
-bool QuickPose::computeWorldPos(const MultiView& multiview, QCluster& cluster, int jointType) {
+template <int V>
+bool QuickPose::computeWorldPos(const MultiView& multiview, QSearch& search, int jointType) {
+	constexpr int bufferSize = V > 0 ? V : 1;
+	Ink::Vec3 fixedOrigins[bufferSize];
+	Ink::Vec3 fixedDirections[bufferSize];
+	Ink::Vec3* origins = V > 0 ? fixedOrigins : search.origins.data();
+	Ink::Vec3* directions = V > 0 ? fixedDirections : search.directions.data();
+	const int views = V > 0 ? V : viewNum;
+	
+	auto& cluster = search.cluster;
 	int rayNum = 0;
-	for (int viewI = 0; viewI < viewNum; ++viewI) {
-		int view = viewOrder[viewI];
+	for (int viewI = 0; viewI < views; ++viewI) {
+		int view = search.viewOrder[viewI];
 		int choice = cluster.getJoint(view, jointType);
 		if (choice == NO_CHOICE) continue;
-		rays[rayNum] = &multiview.views[view].joints[jointType][choice].ray;
-		confs[rayNum] = multiview.views[view].joints[jointType][choice].conf;
-		confs[rayNum] *= confs[rayNum];
+		origins[rayNum] = multiview.getCamera(view).pos;
+		directions[rayNum] = multiview.getDirection(view, jointType, choice);
 		++rayNum;
 	}
 	
 	if (rayNum < 2) return false;
 	
-	cluster.worldPos[jointType] = MathUtils::multiRayIntersect(rays.data(), rayNum);
+	cluster.worldPos[jointType] = MathUtils::multiRayIntersect(origins, directions, rayNum);
 	return true;
 }
 
-void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI, int jointI) {
-	if (jointI == jointOrder.size()) {
-		int validJointNum = 0;
-		
-		int jointOrderNum = static_cast<int>(jointOrder.size());
-		for (int jointI = 0; jointI < jointOrderNum; ++jointI) {
-			validJointNum += cluster.getJoint(viewOrder[0], jointOrder[jointI]) != NO_CHOICE;
+template <int V>
+void QuickPose::expand(const MultiView& multiview, QSearch& search, int node) {
+	auto& jointNode = jointTree[node];
+	if (jointNode.isChainEnd) preserve(search, search.cluster, search.cluster.getFingerprint());
+	
+	/* the shared prefix is assigned once, every chain below continues from the same state */
+	for (int child : jointNode.children) {
+		if (search.pool != nullptr && search.pool->isHungry()) {
+			split(search, 0, child);
+		} else {
+			compute<V>(multiview, search, 0, child);
 		}
+	}
+}
+
+void QuickPose::preserve(QSearch& search, const QCluster& cluster, uint64_t fingerprint) {
+	size_t mask = search.clusterSlots.size() - 1;
+	
+	/* the view orders find the same assignment from several main views, keep the best copy */
+	size_t slot = fingerprint & mask;
+	for (; search.clusterSlots[slot] != 0; slot = (slot + 1) & mask) {
+		int clusterI = search.clusterSlots[slot] - 1;
+		if (search.fingerprints[clusterI] != fingerprint) continue;
+		auto& preservedCluster = search.clusters[clusterI];
+		if (!preservedCluster.hasSameAssignment(cluster)) continue;
 		
-//		if (validJointNum > jointOrderNum / 4 * 3) {
-			preservedClusters[clusterNum++] = cluster;
-			++count;
-//		}
-		
-		return; /* Finish */
+		/* on equal scores the lower main view wins, its triangulation is the same whichever thread found it */
+		if (cluster.score > preservedCluster.score ||
+			(cluster.score == preservedCluster.score && cluster.mainView < preservedCluster.mainView)) {
+			preservedCluster = cluster;
+		}
+		return;
 	}
 	
+	if (search.clusterNum == search.clusters.size()) {
+		search.clusters.emplace_back(cluster);
+		search.fingerprints.emplace_back(fingerprint);
+	} else {
+		search.clusters[search.clusterNum] = cluster;
+		search.fingerprints[search.clusterNum] = fingerprint;
+	}
+	search.clusterSlots[slot] = ++search.clusterNum;
+	
+	/* keep the table at most half full */
+	if (search.clusterNum * 2 > search.clusterSlots.size()) {
+		search.clusterSlots.assign(search.clusterSlots.size() * 2, 0);
+		mask = search.clusterSlots.size() - 1;
+		for (int clusterI = 0; clusterI < search.clusterNum; ++clusterI) {
+			slot = search.fingerprints[clusterI] & mask;
+			while (search.clusterSlots[slot] != 0) slot = (slot + 1) & mask;
+			search.clusterSlots[slot] = clusterI + 1;
+		}
+	}
+}
+
+template <int V>
+void QuickPose::compute(const MultiView& multiview, QSearch& search, int viewI, int node) {
+	const int views = V > 0 ? V : viewNum;
+	auto& cluster = search.cluster;
+	auto& viewOrder = search.viewOrder;
+	auto& historyScores = search.historyScores;
+	
+	int jointI = jointTree[node].depth;
 	int view = viewOrder[viewI];
-	int jointType = jointOrder[jointI];
+	int jointType = jointTree[node].type;
 	
 	bool isNotRoot = jointI != 0;
 	
@@ -183,17 +742,28 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 	/* 1. Parent must exist (have choice) */
 	if (!isNotRoot || parentChoice != NO_CHOICE) {
 		
-		int choiceNum = static_cast<int>(multiview.views[view].joints[jointType].size());
+		int choiceNum = multiview.getJointNum(view, jointType);
+		const int* choiceComponents = components.data() + multiview.getJointIndex(view, jointType, 0);
+		
+		/* the first root of the other components would succeed here, so the main view is never skipped */
+		if (!isNotRoot && viewI == 0) successfulShift = choiceNum > 0;
+		
+		/* compressed frames only walk the children the parent detection is connected to */
+		bool isSparse = isNotRoot && multiview.isPAFCompressed();
+		PAFRow row;
+		if (isSparse) row = multiview.getPAFRow(view, parentType, parentChoice, jointType);
+		int candidateNum = isSparse ? row.size : choiceNum;
 		
-		for (int choice = 0; choice < choiceNum; ++choice) {
+		for (int candidate = 0; candidate < candidateNum; ++candidate) {
+			int choice = isSparse ? row.choices[candidate] : candidate;
+			if (choiceComponents[choice] != search.component) continue;
+			
 			float scorePAF = 0.f;
 			if (isNotRoot) {
-				auto& curJoint = multiview.views[view].joints[jointType][choice];
-				auto& parentJoint = multiview.views[view].joints[parentType][parentChoice];
-				scorePAF = multiview.views[view].getPAF(parentJoint, curJoint);
+				scorePAF = isSparse ? row.getValue(candidate) : multiview.getPAF(view, parentType, parentChoice, jointType, choice);
 				
 				/* 2. PAF value must be greater than 0 */
-				if (scorePAF < EPS) continue;
+				if (scorePAF < minAffinity) continue;
 			}
 			
 			bool isValidShift = true;
@@ -202,10 +772,9 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 				int prevView = viewOrder[prevViewI];
 				int prevChoice = cluster.getJoint(prevView, jointType);
 				if (prevChoice != NO_CHOICE) {
-					auto& curJoint = multiview.views[view].joints[jointType][choice];
-					auto& prevJoint = multiview.views[prevView].joints[jointType][prevChoice];
-					float epipolar = multiview.getEpipolar(prevJoint, curJoint);
-					if (epipolar < EPS) {
+					float distance = multiview.getEpipolarDistance(jointType, prevView, prevChoice, view, choice);
+					float epipolar = 1.f - distance / maxEpipolarDistance;
+					if (epipolar < minAffinity) {
 						isValidShift = false;
 						break;
 					}
@@ -220,13 +789,13 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 			cluster.setJoint(view, jointType, choice);
 			cluster.score += scorePAF + scoreEpi;
 			
-			if (viewI == viewNum - 1) {
+			if (viewI == views - 1) {
 				
 				/* Shift to next joint */
 				
 				int view0Choice = cluster.getJoint(viewOrder[0], jointType);
 				
-				computeWorldPos(multiview, cluster, jointType);
+				computeWorldPos<V>(multiview, search, jointType);
 				
 				/* RayNum must be 2 or more, no need to check */
 				
@@ -234,20 +803,23 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 					float boneLength = cluster.worldPos[parentType].distance(cluster.worldPos[jointType]);
 					
 					/* 4. Bone length must satisfy the constraints */
-					if (boneLength > getMaxBoneLength(jointType, parentType)) {
+					if (!boneConstraints.isValid(jointType, parentType, boneLength)) {
 						cluster.setJoint(viewOrder[0], jointType, NO_CHOICE);
 						cluster.score = historyScores[jointI - 1];
 					}
 				}
 				
 				historyScores[jointI] = cluster.score;
-				compute(multiview, cluster, 0, jointI + 1);
+				expand<V>(multiview, search, node);
 				
 				cluster.setJoint(viewOrder[0], jointType, view0Choice);
 				
+			} else if (search.pool != nullptr && search.pool->isHungry()) {
+				/* Shift to the next view on an idle thread */
+				split(search, viewI + 1, node);
 			} else {
 				/* Shift to the next view */
-				compute(multiview, cluster, viewI + 1, jointI);
+				compute<V>(multiview, search, viewI + 1, node);
 			}
 			
 			cluster.setJoint(view, jointType, NO_CHOICE);
@@ -262,7 +834,7 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 	 * 1. Do not skip at the main view (view 0) if there is a successful shift.
 	 * 2. Always skip at other views (view 1, 2...) no matter shift is successful or not.
 	 */
-	if (viewI == viewNum - 1) {
+	if (viewI == views - 1) {
 		
 		/* Shift to the next joint */
 		
@@ -270,7 +842,7 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 		
 		int view0Choice = cluster.getJoint(viewOrder[0], jointType);
 		
-		bool moreThanTwoRays = computeWorldPos(multiview, cluster, jointType);
+		bool moreThanTwoRays = computeWorldPos<V>(multiview, search, jointType);
 		
 		if (!moreThanTwoRays) {
 			cluster.setJoint(viewOrder[0], jointType, NO_CHOICE);
@@ -279,14 +851,14 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 			float boneLength = cluster.worldPos[parentType].distance(cluster.worldPos[jointType]);
 			
 			/* 4. Bone length must satisfy the constraints */
-			if (boneLength > getMaxBoneLength(jointType, parentType)) {
+			if (!boneConstraints.isValid(jointType, parentType, boneLength)) {
 				cluster.setJoint(viewOrder[0], jointType, NO_CHOICE);
 				cluster.score = historyScores[jointI - 1];
 			}
 		}
 		
 		historyScores[jointI] = cluster.score;
-		compute(multiview, cluster, 0, jointI + 1);
+		expand<V>(multiview, search, node);
 		
 		cluster.setJoint(viewOrder[0], jointType, view0Choice);
 		cluster.score = originalScore;
@@ -295,48 +867,46 @@ void QuickPose::compute(const MultiView& multiview, QCluster& cluster, int viewI
 //		if (successfulShift) return; /* Wrong */
 		
 		/* Shift to the next view */
-		compute(multiview, cluster, viewI + 1, jointI);
+		compute<V>(multiview, search, viewI + 1, node);
 		
 	} else if (!successfulShift) {
 		
 		historyScores[jointI] = cluster.score;
-		compute(multiview, cluster, 0, jointI + 1);
+		expand<V>(multiview, search, node);
 	}
 }
 
 MultiPersonPose QuickPose::postProcessing(const MultiView& multiview) {
 	MultiPersonPose multiPersonPose;
+	multiPersonPose.reserve(maxPersonNum);
 	
-	/* view, joint, choice => person */
-	std::vector<std::vector<std::vector<int> > > VJCPersons(viewNum);
-	for (int view = 0; view < viewNum; ++view) {
-		VJCPersons[view].resize(typeNum);
-		for (int type = 0; type < typeNum; ++type) {
-			VJCPersons[view][type].resize(multiview.views[view].joints[type].size(), -1);
-		}
-	}
-	
-	/* view, joint, person => choice */
-	std::vector<std::vector<std::vector<int> > > VJPChoices(viewNum);
-	for (int view = 0; view < viewNum; ++view) {
-		VJPChoices[view].resize(typeNum);
-		for (int type = 0; type < typeNum; ++type) {
-			VJPChoices[view][type].resize(maxPersonNum, NO_CHOICE);
-		}
-	}
+	/**
+	 * Detections are bits of their joint index. Per person, claimed holds its
+	 * detections and blocked the other candidates of every view and type it
+	 * already has, so both conflict tests are word-wide ANDs.
+	 */
+	int wordNum = (multiview.getTotalJointNum() + 63) / 64;
+	bitsets.assign(static_cast<size_t>(wordNum) * (2 + maxPersonNum * 2), 0);
+	uint64_t* claimedBits = bitsets.data();
+	uint64_t* clusterBits = claimedBits + wordNum;
+	auto getPersonBits = [&](int person) -> uint64_t* {
+		return clusterBits + wordNum * (1 + person);
+	};
+	auto getBlockedBits = [&](int person) -> uint64_t* {
+		return clusterBits + wordNum * (1 + maxPersonNum + person);
+	};
 	
-	std::sort(preservedClusters.data(), preservedClusters.data() + clusterNum,
-			  [](const QCluster& cluster1, const QCluster& cluster2) -> bool {
-		return cluster1.score > cluster2.score;
-	});
+	personChoices.assign(static_cast<size_t>(maxPersonNum) * viewNum * typeNum, NO_CHOICE);
+	auto getPersonChoices = [&](int person) -> int* {
+		return personChoices.data() + static_cast<size_t>(person) * viewNum * typeNum;
+	};
 	
-	for (int clusterI = 0; clusterI < clusterNum; ++clusterI) {
-		auto& cluster = preservedClusters[clusterI];
+	/* preservedClusters are already sorted best first */
+	for (auto* preservedCluster : preservedClusters) {
+		auto& cluster = *preservedCluster;
 		int mainView = cluster.mainView;
 		
-		bool isConflicting = false;
-		bool isContributing = false;
-		int personID = -1;
+		std::fill(clusterBits, clusterBits + wordNum, 0);
 		for (int type = 0; type < typeNum; ++type) {
 			if (cluster.getJoint(mainView, type) == NO_CHOICE) {
 				continue;
@@ -344,82 +914,96 @@ MultiPersonPose QuickPose::postProcessing(const MultiView& multiview) {
 			for (int view = 0; view < viewNum; ++view) {
 				int choice = cluster.getJoint(view, type);
 				if (choice == NO_CHOICE) continue;
-				int VJCPersonID = VJCPersons[view][type][choice];
-				if (VJCPersonID == -1) {
-					isContributing = true;
-				} else if (personID == -1) {
-					personID = VJCPersonID;
-				} else if (personID != VJCPersonID) {
-					isConflicting = true;
-					break;
-				}
+				int joint = multiview.getJointIndex(view, type, choice);
+				clusterBits[joint >> 6] |= 1ULL << (joint & 63);
 			}
-			if (isConflicting) break;
 		}
 		
-		if (isConflicting || !isContributing) continue;
+		bool isContributing = false;
+		for (int word = 0; word < wordNum; ++word) {
+			isContributing |= (clusterBits[word] & ~claimedBits[word]) != 0;
+		}
+		if (!isContributing) continue;
+		
+		/* the detections already claimed must all belong to the same person */
+		bool isConflicting = false;
+		int personID = -1;
+		int personNum = static_cast<int>(multiPersonPose.size());
+		for (int person = 0; person < personNum && !isConflicting; ++person) {
+			const uint64_t* personBits = getPersonBits(person);
+			bool isShared = false;
+			for (int word = 0; word < wordNum; ++word) {
+				isShared |= (clusterBits[word] & personBits[word]) != 0;
+			}
+			if (!isShared) continue;
+			if (personID == -1) {
+				personID = person;
+			} else {
+				isConflicting = true;
+			}
+		}
+		
+		if (isConflicting) continue;
 		
 		if (personID == -1) {
+			if (multiPersonPose.size() == maxPersonNum) continue;
 			personID = static_cast<int>(multiPersonPose.size());
 			Pose pose;
 			pose.ID = personID;
-			pose.hasJoint.resize(typeNum);
-			pose.jointPos.resize(typeNum);
 			multiPersonPose.emplace_back(pose);
 		} else {
-			for (int type = 0; type < typeNum; ++type) {
-				if (cluster.getJoint(mainView, type) == NO_CHOICE) {
-					continue;
-				}
-				for (int view = 0; view < viewNum; ++view) {
-					int choice = cluster.getJoint(view, type);
-					if (choice == NO_CHOICE) continue;
-					int VJPChoice = VJPChoices[view][type][personID];
-					if (VJPChoice != NO_CHOICE && choice != VJPChoice) {
-						isConflicting = true;
-						break;
-					}
-				}
-				if (isConflicting) break;
+			const uint64_t* blockedBits = getBlockedBits(personID);
+			for (int word = 0; word < wordNum; ++word) {
+				isConflicting |= (clusterBits[word] & blockedBits[word]) != 0;
 			}
 			if (isConflicting) continue;
 		}
 		
 		auto& curPose = multiPersonPose[personID];
+		int* choices = getPersonChoices(personID);
+		uint64_t* personBits = getPersonBits(personID);
+		uint64_t* blockedBits = getBlockedBits(personID);
+		for (int word = 0; word < wordNum; ++word) {
+			personBits[word] |= clusterBits[word];
+			claimedBits[word] |= clusterBits[word];
+		}
 		
 		for (int type = 0; type < typeNum; ++type) {
+			if (cluster.getJoint(mainView, type) == NO_CHOICE) {
+				continue;
+			}
 			for (int view = 0; view < viewNum; ++view) {
-				if (cluster.getJoint(mainView, type) == NO_CHOICE) {
-					continue;
-				}
 				int choice = cluster.getJoint(view, type);
 				if (choice == NO_CHOICE) continue;
-				VJCPersons[view][type][choice] = personID;
-				VJPChoices[view][type][personID] = choice;
-				if (!curPose.hasJoint[type]) {
-					curPose.hasJoint[type] = true;
-					curPose.jointPos[type] = cluster.worldPos[type];
+				choices[view * typeNum + type] = choice;
+				int start = multiview.getJointIndex(view, type, 0);
+				for (int joint = start; joint < start + multiview.getJointNum(view, type); ++joint) {
+					if (joint != start + choice) blockedBits[joint >> 6] |= 1ULL << (joint & 63);
 				}
 			}
+			if (!curPose.hasJoint(type)) {
+				curPose.setJoint(type, cluster.worldPos[type]);
+			}
 		}
 	}
 	
 //	for (auto& pose : multiPersonPose) {
-//		if (pose.hasJoint.empty()) continue;
+//		if (pose.isEmpty()) continue;
 //		for (int type = 0; type < typeNum; ++type) {
-//			if (pose.hasJoint[type]) {
+//			if (pose.hasJoint(type)) {
 //				int rayNum = 0;
 //				for (int view = 0; view < viewNum; ++view) {
 //					int choice = VJPChoices[view][type][pose.ID];
 //					if (choice == NO_CHOICE) continue;
-//					rays[rayNum++] = &multiview.views[view].joints[type][choice].ray;
+//					origins[rayNum] = multiview.getCamera(view).pos;
+//					directions[rayNum++] = multiview.getDirection(view, type, choice);
 //				}
 //
 //				if (rayNum < 2) {
 //					std::cerr << "Error: rayNum should be greater than 2\n";
 //				}
 //
-//				pose.jointPos[type] = MathUtils::multiRayIntersect(rays.data(), rayNum);
+//				pose.jointPos[type] = MathUtils::multiRayIntersect(origins.data(), directions.data(), rayNum);
 //			}
 //		}
 //	}
@@ -427,16 +1011,155 @@ MultiPersonPose QuickPose::postProcessing(const MultiView& multiview) {
 	return multiPersonPose;
 }
 
-float QuickPose::getMaxBoneLength(int jointTypeA, int jointTypeB) const {
-	if (maxBoneLengths.count(jointTypeA + jointTypeB * I16) != 0) {
-		return maxBoneLengths.at(jointTypeA + jointTypeB * I16);
-	}
-	if (maxBoneLengths.count(jointTypeA * I16 + jointTypeB) != 0) {
-		return maxBoneLengths.at(jointTypeA * I16 + jointTypeB);
+void QuickPose::attachJoints(const MultiView& multiview, MultiPersonPose& multiPersonPose) {
+	int personNum = static_cast<int>(multiPersonPose.size());
+	auto& search = searches[0];
+	std::vector<std::pair<float, int> > edges;
+	std::vector<unsigned char> isTaken;
+	std::vector<unsigned char> isMatched(personNum);
+	std::vector<float> matchedScores(personNum * viewNum);
+	std::vector<int> matchedViews(viewNum);
+	
+	for (int type : attachedJoints) {
+		int parentType = parents[type];
+		
+		for (int view = 0; view < viewNum; ++view) {
+			int choiceNum = multiview.getJointNum(view, type);
+			if (choiceNum == 0) continue;
+			
+			/* edges are (PAF, person * choiceNum + choice), only parents fixed in this view take part */
+			edges.clear();
+			for (int person = 0; person < personNum; ++person) {
+				int parentChoice = personChoices[(static_cast<size_t>(person) * viewNum + view) * typeNum + parentType];
+				if (parentChoice == NO_CHOICE) continue;
+				if (multiview.isPAFCompressed()) {
+					PAFRow row = multiview.getPAFRow(view, parentType, parentChoice, type);
+					for (int index = 0; index < row.size; ++index) {
+						float scorePAF = row.getValue(index);
+						if (scorePAF < minAffinity) continue;
+						edges.emplace_back(scorePAF, person * choiceNum + row.choices[index]);
+					}
+					continue;
+				}
+				for (int choice = 0; choice < choiceNum; ++choice) {
+					float scorePAF = multiview.getPAF(view, parentType, parentChoice, type, choice);
+					if (scorePAF < minAffinity) continue;
+					edges.emplace_back(scorePAF, person * choiceNum + choice);
+				}
+			}
+			std::sort(edges.begin(), edges.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) -> bool {
+				return a.first > b.first;
+			});
+			
+			isTaken.assign(choiceNum, 0);
+			std::fill(isMatched.begin(), isMatched.end(), 0);
+			for (auto& edge : edges) {
+				int person = edge.second / choiceNum;
+				int choice = edge.second % choiceNum;
+				if (isMatched[person] || isTaken[choice]) continue;
+				isMatched[person] = 1;
+				isTaken[choice] = 1;
+				personChoices[(static_cast<size_t>(person) * viewNum + view) * typeNum + type] = choice;
+				matchedScores[person * viewNum + view] = edge.first;
+			}
+		}
+		
+		/**
+		 * Views are kept by descending PAF while they agree epipolarly with the
+		 * kept ones, then triangulated. Joints failing the bone constraints are
+		 * dropped, so their children are not attached either.
+		 */
+		for (int person = 0; person < personNum; ++person) {
+			auto& pose = multiPersonPose[person];
+			int* choices = personChoices.data() + static_cast<size_t>(person) * viewNum * typeNum;
+			int matchedNum = 0;
+			for (int view = 0; view < viewNum; ++view) {
+				if (choices[view * typeNum + type] != NO_CHOICE) matchedViews[matchedNum++] = view;
+			}
+			std::sort(matchedViews.begin(), matchedViews.begin() + matchedNum, [&](int a, int b) -> bool {
+				return matchedScores[person * viewNum + a] > matchedScores[person * viewNum + b];
+			});
+			
+			int rayNum = 0;
+			for (int matchedI = 0; matchedI < matchedNum; ++matchedI) {
+				int view = matchedViews[matchedI];
+				int choice = choices[view * typeNum + type];
+				bool isConsistent = true;
+				for (int keptI = 0; keptI < rayNum && isConsistent; ++keptI) {
+					int keptView = matchedViews[keptI];
+					float distance = multiview.getEpipolarDistance(type, keptView, choices[keptView * typeNum + type], view, choice);
+					isConsistent = 1.f - distance / maxEpipolarDistance >= minAffinity;
+				}
+				if (!isConsistent) {
+					choices[view * typeNum + type] = NO_CHOICE;
+					continue;
+				}
+				matchedViews[rayNum] = view;
+				search.origins[rayNum] = multiview.getCamera(view).pos;
+				search.directions[rayNum] = multiview.getDirection(view, type, choice);
+				++rayNum;
+			}
+			
+			bool isValid = rayNum >= 2 && pose.hasJoint(parentType);
+			if (isValid) {
+				Ink::Vec3 jointPos = MathUtils::multiRayIntersect(search.origins.data(), search.directions.data(), rayNum);
+				isValid = boneConstraints.isValid(type, parentType, jointPos.distance(pose.jointPos[parentType]));
+				if (isValid) pose.setJoint(type, jointPos);
+			}
+			if (!isValid) {
+				for (int view = 0; view < viewNum; ++view) {
+					choices[view * typeNum + type] = NO_CHOICE;
+				}
+			}
+		}
 	}
-	return std::numeric_limits<float>::max();
+}
+
+const std::vector<int>& QuickPose::getParents() const {
+	return parents;
+}
+
+float QuickPose::getMaxBoneLength(int jointTypeA, int jointTypeB) const {
+	return boneConstraints.getMaxLength(jointTypeA, jointTypeB);
 }
 
 void QuickPose::setMaxBoneLength(int jointTypeA, int jointTypeB, float length) {
-	maxBoneLengths.insert_or_assign(jointTypeA + jointTypeB * I16, length);
+	boneConstraints.setMaxLength(jointTypeA, jointTypeB, length);
+}
+
+const BoneConstraints& QuickPose::getBoneConstraints() const {
+	return boneConstraints;
+}
+
+void QuickPose::setBoneConstraints(const BoneConstraints& constraints) {
+	boneConstraints = constraints;
+	boneConstraints.resize(static_cast<int>(parents.size()));
+}
+
+void QuickPose::setMaxPersonNum(int personNum) {
+	maxPersonNum = personNum;
+}
+
+void QuickPose::setMaxClusterNum(int clusterNum) {
+	maxClusterNum = clusterNum;
+}
+
+void QuickPose::setMaxEpipolarDistance(float distance) {
+	maxEpipolarDistance = distance;
+}
+
+void QuickPose::setMinAffinity(float affinity) {
+	minAffinity = affinity;
+}
+
+void QuickPose::setThreadNum(int threadNum) {
+	this->threadNum = threadNum;
+}
+
+void QuickPose::setSeedVoxelSize(float size) {
+	seedVoxelSize = size;
+}
+
+void QuickPose::setMinSeedVoteNum(int voteNum) {
+	minSeedVoteNum = voteNum;
 }
@@ -22,13 +22,19 @@
 
 #pragma once
 
-#include "Views.h"
+#include "BoneConstraints.h"
+#include "WorkStealingPool.h"
+
+#include <memory>
 
 class QCluster {
 public:
 	int mainView = 0;
 	float score = 0;
-	std::vector<std::vector<int> > choices;
+	int typeNum = 0;
+	
+	/* view by view, typeNum choices per view */
+	std::vector<int> choices;
 	std::vector<Ink::Vec3> worldPos;
 	
 	explicit QCluster() = default;
@@ -38,6 +44,83 @@ public:
 	int getJoint(int view, int type) const;
 	
 	void setJoint(int view, int type, int choice);
+	
+	/* hash of the choices and of the joint types seen by the main view */
+	uint64_t getFingerprint() const;
+	
+	/* clusters with the same assignment behave the same in post-processing */
+	bool hasSameAssignment(const QCluster& cluster) const;
+};
+
+/* node of the joint order trie, chains sharing a prefix share its nodes */
+class QJointNode {
+public:
+	int type = 0;
+	int depth = 0;
+	bool isChainEnd = false;
+	std::vector<int> children;
+	
+	explicit QJointNode() = default;
+};
+
+/* epipolar-consistent pair of root detections, votes for the voxel of its triangulation */
+class QRootPair {
+public:
+	long long voxel = 0;
+	int viewA = 0;
+	int choiceA = 0;
+	int viewB = 0;
+	int choiceB = 0;
+	float score = 0;
+	Ink::Vec3 pos;
+	
+	explicit QRootPair() = default;
+};
+
+/* root joint proposal from the voxel vote, its supporting views are assigned up front */
+class QSeed {
+public:
+	long long voxel = 0;
+	int component = 0;
+	int voteNum = 0;
+	float score = 0;
+	std::vector<int> choices;
+	
+	explicit QSeed() = default;
+};
+
+/* subtree of the search split off for another thread, node -1 searches the whole component */
+class QTask {
+public:
+	int component = 0;
+	int viewI = 0;
+	int node = -1;
+	QCluster cluster;
+	std::vector<int> viewOrder;
+	std::vector<float> historyScores;
+	
+	explicit QTask() = default;
+};
+
+/* state of one depth-first search, each association thread owns one */
+class QSearch {
+public:
+	int thread = 0;
+	WorkStealingPool<QTask>* pool = nullptr;
+	int component = 0;
+	int clusterNum = 0;
+	QCluster cluster;
+	std::vector<int> viewOrder;
+	std::vector<float> historyScores;
+	std::vector<Ink::Vec3> origins;
+	std::vector<Ink::Vec3> directions;
+	std::vector<QCluster> clusters;
+	
+	/* open-addressing table of cluster indices plus one, keyed by fingerprint */
+	std::vector<int> clusterSlots;
+	std::vector<uint64_t> fingerprints;
+	
+	explicit QSearch() = default;
 };
 
 class QuickPose {
@@ -50,10 +133,51 @@ public:
 	
 	MultiPersonPose compute(const MultiView& multiview);
 	
+	/* joint chains searched from the root, each finished chain yields a cluster */
+	void setJointOrders(const std::vector<std::vector<int> >& jointOrders);
+	
+	/**
+	 * Two-phase association: only the torso joints of the joint orders are
+	 * searched across views, every other joint is attached per view by PAF
+	 * matching to its already fixed parent and then triangulated. Empty
+	 * searches every joint.
+	 */
+	void setTorsoJoints(const std::vector<int>& jointTypes);
+	
+	const std::vector<int>& getParents() const;
+	
 	float getMaxBoneLength(int jointTypeA, int jointTypeB) const;
 	
 	void setMaxBoneLength(int jointTypeA, int jointTypeB, float length);
 	
+	const BoneConstraints& getBoneConstraints() const;
+	
+	/* replaces every bone limit, minimum lengths prune the search as well */
+	void setBoneConstraints(const BoneConstraints& constraints);
+	
+	void setMaxPersonNum(int personNum);
+	
+	void setMaxClusterNum(int clusterNum);
+	
+	void setMaxEpipolarDistance(float distance);
+	
+	void setMinAffinity(float affinity);
+	
+	/* threads of the association search, 0 uses Parallel::getThreadNum */
+	void setThreadNum(int threadNum);
+	
+	/**
+	 * Seeds the search from triangulated root proposals instead of enumerating
+	 * every cross-view root combination. Root pairs are voted into voxels of
+	 * this size, 0 disables seeding. Nearby proposals that pick different root
+	 * detections are all kept, the search tells them apart. Joint orders that
+	 * start at another joint are still searched exhaustively.
+	 */
+	void setSeedVoxelSize(float size);
+	
+	/* votes a proposal needs within its voxel neighborhood */
+	void setMinSeedVoteNum(int voteNum);
+	
 private:
 	int viewNum = 0;
 	
@@ -65,27 +189,97 @@ private:
 	
 	int maxClusterNum = 100000;
 	
-	int clusterNum = 0;
+	float maxEpipolarDistance = 0.1f;
+	
+	float minAffinity = 0.0001f;
+	
+	int threadNum = 0;
+	
+	float seedVoxelSize = 0;
+	
+	int minSeedVoteNum = 3;
 	
 	std::vector<int> parents;
 	
-	std::vector<int> viewOrder;
+	/* every rotation of the views, each view leads once */
+	std::vector<std::vector<int> > viewOrders;
 	
-	std::vector<int> jointOrder;
+	std::vector<std::vector<int> > jointOrders;
 	
-	std::vector<float> historyScores;
+	std::vector<int> torsoJoints;
+	
+	/* joints of the orders left out of the search, every parent before its children */
+	std::vector<int> attachedJoints;
+	
+	/* trie of the searched joint orders, the first nodes are the roots */
+	std::vector<QJointNode> jointTree;
 	
-	std::vector<float> confs;
+	int jointTreeRootNum = 0;
 	
-	std::vector<const Ink::Ray*> rays;
+	BoneConstraints boneConstraints;
 	
-	std::unordered_map<unsigned int, float> maxBoneLengths;
+	/* connected component of each joint index, linked by PAF and epipolar affinities */
+	std::vector<int> components;
 	
-	std::vector<QCluster> preservedClusters;
+	/* components holding a root candidate, only these can produce clusters */
+	std::vector<int> rootComponents;
 	
-	bool computeWorldPos(const MultiView& multiview, QCluster& cluster, int jointType);
+	std::vector<QRootPair> rootPairs;
 	
-	void compute(const MultiView& multiview, QCluster& cluster, int viewI, int jointI);
+	std::vector<QSeed> seeds;
+	
+	std::vector<QSearch> searches;
+	
+	/* created on the first threaded frame and kept while the thread count stays the same */
+	std::unique_ptr<WorkStealingPool<QTask> > pool;
+	
+	/* best maxClusterNum clusters of all threads, by score and then fingerprint */
+	std::vector<const QCluster*> preservedClusters;
+	
+	/* claimed and blocked detections of every person, reused across frames */
+	std::vector<uint64_t> bitsets;
+	
+	/* choice of every person, view and type, persons are maxPersonNum apart */
+	std::vector<int> personChoices;
+	
+	void buildJointTree();
+	
+	void computeComponents(const MultiView& multiview);
+	
+	void computeSeeds(const MultiView& multiview);
+	
+	/* picks the kernel compiled for the rig's view count, or the generic one */
+	void run(const MultiView& multiview, QSearch& search, QTask& task);
+	
+	/**
+	 * Search kernels are templated on the view count V so view loops have
+	 * fixed bounds and ray buffers live on the stack. V = 0 is the generic
+	 * kernel that reads the view count at runtime.
+	 */
+	template <int V>
+	void run(const MultiView& multiview, QSearch& search, QTask& task);
+	
+	template <int V>
+	void search(const MultiView& multiview, QSearch& search, int component);
+	
+	template <int V>
+	bool computeWorldPos(const MultiView& multiview, QSearch& search, int jointType);
+	
+	template <int V>
+	void compute(const MultiView& multiview, QSearch& search, int viewI, int node);
+	
+	/* continues with every chain below a node once it is assigned */
+	template <int V>
+	void expand(const MultiView& multiview, QSearch& search, int node);
+	
+	/* hands compute(viewI, node) on the current state to an idle thread */
+	void split(QSearch& search, int viewI, int node);
+	
+	/* stores the cluster unless a better copy is stored, equal scores keep the lower main view */
+	void preserve(QSearch& search, const QCluster& cluster, uint64_t fingerprint);
 	
 	MultiPersonPose postProcessing(const MultiView& multiview);
+	
+	/* greedy bipartite matching of persons and candidates per view, by descending PAF */
+	void attachJoints(const MultiView& multiview, MultiPersonPose& multiPersonPose);
 };
@@ -0,0 +1,106 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+/**
+ * Bounded lock-free ring for exactly one producer thread and one consumer
+ * thread. The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class SPSCRing {
+public:
+	explicit SPSCRing(size_t capacity);
+	
+	SPSCRing(const SPSCRing&) = delete;
+	
+	SPSCRing& operator=(const SPSCRing&) = delete;
+	
+	/* producer side, returns false when the ring is full */
+	bool push(T&& value);
+	
+	/* consumer side, returns false when the ring is empty */
+	bool pop(T& value);
+	
+	size_t size() const;
+	
+	size_t getCapacity() const;
+	
+private:
+	std::vector<T> slots;
+	
+	size_t mask = 0;
+	
+	alignas(64) std::atomic<size_t> head = 0;
+	
+	alignas(64) std::atomic<size_t> tail = 0;
+	
+	/* each side caches the other index so it only reloads it when needed */
+	alignas(64) size_t cachedHead = 0;
+	
+	alignas(64) size_t cachedTail = 0;
+};
+
+template <typename T>
+SPSCRing<T>::SPSCRing(size_t capacity) {
+	size_t roundedCapacity = 1;
+	while (roundedCapacity < capacity) roundedCapacity <<= 1;
+	slots.resize(roundedCapacity);
+	mask = roundedCapacity - 1;
+}
+
+template <typename T>
+bool SPSCRing<T>::push(T&& value) {
+	size_t curTail = tail.load(std::memory_order_relaxed);
+	if (curTail - cachedHead == slots.size()) {
+		cachedHead = head.load(std::memory_order_acquire);
+		if (curTail - cachedHead == slots.size()) return false;
+	}
+	slots[curTail & mask] = std::move(value);
+	tail.store(curTail + 1, std::memory_order_release);
+	return true;
+}
+
+template <typename T>
+bool SPSCRing<T>::pop(T& value) {
+	size_t curHead = head.load(std::memory_order_relaxed);
+	if (curHead == cachedTail) {
+		cachedTail = tail.load(std::memory_order_acquire);
+		if (curHead == cachedTail) return false;
+	}
+	value = std::move(slots[curHead & mask]);
+	head.store(curHead + 1, std::memory_order_release);
+	return true;
+}
+
+template <typename T>
+size_t SPSCRing<T>::size() const {
+	return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t SPSCRing<T>::getCapacity() const {
+	return slots.size();
+}
@@ -23,54 +23,215 @@
 #include "ShelfLoader.h"
 
 #include "Ink.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
 
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
-MultiPersonPoses ShelfLoader::loadGroundTruth(const std::string& path) {
-	std::ifstream stream(path, std::fstream::in);
+/* Binary sidecar written next to the ground truth text after the first parse */
+constexpr char GT_CACHE_MAGIC[4] = {'M', 'G', 'T', 'C'};
+constexpr unsigned GT_CACHE_VERSION = 2;
+
+struct GroundTruthCacheHeader {
+	char magic[4];
+	unsigned version;
+	unsigned long long sourceSize;
+	long long sourceTime;
+	unsigned frameNum;
+	unsigned personNum;
+	unsigned jointNum;
+};
+
+static int countJoints(unsigned long long jointMask) {
+	int jointNum = 0;
+	for (; jointMask != 0; jointMask &= jointMask - 1) ++jointNum;
+	return jointNum;
+}
+
+static bool loadGroundTruthCache(const std::string& path, const MappedFile& source, MultiPersonPoses& multiPersonPoses) {
+	MappedFile cache(path);
+	if (!cache.isOpen() || cache.size() < sizeof(GroundTruthCacheHeader)) return false;
+	
+	GroundTruthCacheHeader header;
+	memcpy(&header, cache.data(), sizeof(GroundTruthCacheHeader));
+	if (memcmp(header.magic, GT_CACHE_MAGIC, 4) != 0) return false;
+	if (header.version != GT_CACHE_VERSION) return false;
+	if (header.sourceSize != source.size()) return false;
+	if (header.sourceTime != source.getModifiedTime()) return false;
+	
+	size_t expectedSize = sizeof(GroundTruthCacheHeader) + header.frameNum * sizeof(unsigned) +
+		header.personNum * (sizeof(int) + sizeof(unsigned long long)) + header.jointNum * sizeof(Ink::Vec3);
+	if (cache.size() != expectedSize) return false;
+	
+	const char* cursor = cache.data() + sizeof(GroundTruthCacheHeader);
+	const char* personNums = cursor;
+	const char* IDs = personNums + header.frameNum * sizeof(unsigned);
+	const char* jointMasks = IDs + header.personNum * sizeof(int);
+	const char* positions = jointMasks + header.personNum * sizeof(unsigned long long);
+	
+	multiPersonPoses.resize(header.frameNum);
+	size_t personIndex = 0;
+	for (auto& multiPersonPose : multiPersonPoses) {
+		unsigned personNum = 0;
+		memcpy(&personNum, personNums, sizeof(unsigned));
+		personNums += sizeof(unsigned);
+		if (personIndex + personNum > header.personNum) return false;
+		multiPersonPose.resize(personNum);
+		for (auto& pose : multiPersonPose) {
+			unsigned long long jointMask = 0;
+			memcpy(&pose.ID, IDs, sizeof(int));
+			memcpy(&jointMask, jointMasks, sizeof(unsigned long long));
+			IDs += sizeof(int);
+			jointMasks += sizeof(unsigned long long);
+			if (jointMask >> Pose::JOINT_NUM != 0) return false;
+			if (positions + countJoints(jointMask) * sizeof(Ink::Vec3) > cache.data() + cache.size()) return false;
+			pose.clearJoints();
+			for (int type = 0; type < Pose::JOINT_NUM; ++type) {
+				if (!((jointMask >> type) & 1)) continue;
+				Ink::Vec3 pos;
+				memcpy(&pos, positions, sizeof(Ink::Vec3));
+				pose.setJoint(type, pos);
+				positions += sizeof(Ink::Vec3);
+			}
+			++personIndex;
+		}
+	}
+	return true;
+}
+
+static void saveGroundTruthCache(const std::string& path, const MappedFile& source, const MultiPersonPoses& multiPersonPoses) {
+	GroundTruthCacheHeader header;
+	memcpy(header.magic, GT_CACHE_MAGIC, 4);
+	header.version = GT_CACHE_VERSION;
+	header.sourceSize = source.size();
+	header.sourceTime = source.getModifiedTime();
+	header.frameNum = static_cast<unsigned>(multiPersonPoses.size());
+	header.personNum = 0;
+	header.jointNum = 0;
+	
+	std::vector<unsigned> personNums;
+	std::vector<int> IDs;
+	std::vector<unsigned long long> jointMasks;
+	personNums.reserve(multiPersonPoses.size());
+	for (auto& multiPersonPose : multiPersonPoses) {
+		personNums.emplace_back(static_cast<unsigned>(multiPersonPose.size()));
+		for (auto& pose : multiPersonPose) {
+			IDs.emplace_back(pose.ID);
+			jointMasks.emplace_back(pose.jointMask);
+			header.jointNum += countJoints(pose.jointMask);
+		}
+	}
+	header.personNum = static_cast<unsigned>(IDs.size());
+	
+	/* write to a temporary file first so a partial cache is never picked up */
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream stream(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (stream.fail()) return;
+	
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(GroundTruthCacheHeader));
+	stream.write(reinterpret_cast<const char*>(personNums.data()), personNums.size() * sizeof(unsigned));
+	stream.write(reinterpret_cast<const char*>(IDs.data()), IDs.size() * sizeof(int));
+	stream.write(reinterpret_cast<const char*>(jointMasks.data()), jointMasks.size() * sizeof(unsigned long long));
+	for (auto& multiPersonPose : multiPersonPoses) {
+		for (auto& pose : multiPersonPose) {
+			for (int type = 0; type < Pose::JOINT_NUM; ++type) {
+				if (!pose.hasJoint(type)) continue;
+				stream.write(reinterpret_cast<const char*>(&pose.jointPos[type]), sizeof(Ink::Vec3));
+			}
+		}
+	}
+	stream.close();
 	
 	if (stream.fail()) {
-		std::cerr << "ShelfLoader: Failed to load ground truth\n";
-		return MultiPersonPoses();
+		std::remove(temporaryPath.c_str());
+		return;
+	}
+	std::rename(temporaryPath.c_str(), path.c_str());
+}
+
+static bool parseGroundTruth(const MappedFile& source, MultiPersonPoses& multiPersonPoses) {
+	const char* begin = source.data();
+	const char* end = begin + source.size();
+	
+	/* first pass counts frames and persons so every vector is sized once */
+	std::vector<unsigned> personNums;
+	TextScanner counter(begin, end);
+	while (!counter.isEnd()) {
+		std::string_view keyword = counter.nextToken();
+		if (keyword == "frame") {
+			personNums.emplace_back(0);
+		} else if (keyword == "p") {
+			if (personNums.empty()) return false;
+			++personNums.back();
+		}
+		counter.skipLine();
 	}
 	
-	size_t streamMax = std::numeric_limits<std::streamsize>::max();
+	multiPersonPoses.resize(personNums.size());
+	for (size_t i = 0; i < personNums.size(); ++i) {
+		multiPersonPoses[i].resize(personNums[i]);
+	}
 	
-	MultiPersonPoses multiPersonPoses;
+	/* joints of a person are listed in type order */
 	MultiPersonPose* curMultiPersonPose = nullptr;
 	Pose* curPose = nullptr;
-	
-	while (!stream.eof()) {
-		std::string keyword;
-		stream >> keyword;
-		
+	size_t frameIndex = 0;
+	size_t poseIndex = 0;
+	int jointIndex = 0;
+	TextScanner scanner(begin, end);
+	while (!scanner.isEnd()) {
+		std::string_view keyword = scanner.nextToken();
 		if (keyword == "frame") {
-			int frameIndex = 0;
-			stream >> frameIndex;
-			multiPersonPoses.emplace_back(MultiPersonPose());
-			curMultiPersonPose = &multiPersonPoses.back();
-		}
-		
-		else if (keyword == "p") {
-			curMultiPersonPose->emplace_back(Pose());
-			curPose = &curMultiPersonPose->back();
-			stream >> curPose->ID;
-		}
-		
-		else if (keyword == "v") {
+			curMultiPersonPose = &multiPersonPoses[frameIndex++];
+			poseIndex = 0;
+		} else if (keyword == "p") {
+			curPose = &(*curMultiPersonPose)[poseIndex++];
+			jointIndex = 0;
+			if (!scanner.nextInt(curPose->ID)) return false;
+		} else if (keyword == "v") {
 			Ink::Vec3 pos;
-			stream >> pos.x >> pos.y >> pos.z;
-			curPose->hasJoint.emplace_back(true);
-			curPose->jointPos.emplace_back(pos);
-		}
-		
-		else {
-			stream.ignore(streamMax, '\n');
+			if (curPose == nullptr || jointIndex == Pose::JOINT_NUM) return false;
+			if (!scanner.nextFloat(pos.x) || !scanner.nextFloat(pos.y) || !scanner.nextFloat(pos.z)) return false;
+			curPose->setJoint(jointIndex++, pos);
 		}
+		scanner.skipLine();
 	}
+	return true;
+}
+
+MultiPersonPoses ShelfLoader::loadGroundTruth(const std::string& path) {
+	MappedFile source(path);
 	
-	stream.close();
+	if (!source.isOpen()) {
+		std::cerr << "ShelfLoader: Failed to load ground truth\n";
+		return MultiPersonPoses();
+	}
+	
+	MultiPersonPoses multiPersonPoses;
+	std::string cachePath = path + ".cache";
+	if (loadGroundTruthCache(cachePath, source, multiPersonPoses)) return multiPersonPoses;
+	
+	multiPersonPoses.clear();
+	if (!parseGroundTruth(source, multiPersonPoses)) {
+		std::cerr << "ShelfLoader: Failed to parse ground truth\n";
+		return MultiPersonPoses();
+	}
+	
+	saveGroundTruthCache(cachePath, source, multiPersonPoses);
 	
 	return multiPersonPoses;
 }
+
+BoneConstraints ShelfLoader::learnBoneConstraints(const MultiPersonPoses& multiPersonPoses, const std::vector<int>& parents,
+												 float percentile, bool isMinLearned) {
+	auto constraints = BoneConstraints::learn(multiPersonPoses, parents, percentile, isMinLearned);
+	
+	/* Ears are bounded by the neck-to-nose and shoulder lengths */
+	constraints.setMaxLength(2, 17, constraints.getMaxLength(0, 1) + constraints.getMaxLength(1, 2));
+	constraints.setMaxLength(5, 18, constraints.getMaxLength(0, 1) + constraints.getMaxLength(1, 5));
+	
+	return constraints;
+}
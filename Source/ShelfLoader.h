@@ -22,11 +22,15 @@
 
 #pragma once
 
-#include "Views.h"
+#include "BoneConstraints.h"
 
 class ShelfLoader {
 public:
 	static MultiView loadDataset(const std::string& path);
 	
 	static MultiPersonPoses loadGroundTruth(const std::string& path);
+	
+	/* learns from ground truth converted to the layout of parents, Shelf has no ears so they are derived */
+	static BoneConstraints learnBoneConstraints(const MultiPersonPoses& multiPersonPoses, const std::vector<int>& parents,
+												float percentile = 0, bool isMinLearned = false);
 };
@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SkeletonConverter.h"
+
+#include "Parallel.h"
+
+/* Incorrect conversion */
+const SkeletonMapping SkeletonConverter::SHELF_TO_BODY25 = {
+	{13, 12, 8, 7, 6, 9, 10, 11, -1, 2, 1, 0, 3, 4, 5},
+	{{8, 2, 3}},
+};
+
+const SkeletonMapping SkeletonConverter::SKEL19_TO_BODY25 = {
+	{4, 1, 5, 11, 15, 6, 12, 16, 0, 2, 7, 13, 3, 8, 14, -1, -1, 9, 10, 17, -1, -1, 18, -1, -1},
+	{},
+};
+
+const SkeletonMapping SkeletonConverter::COCO17_TO_BODY25 = {
+	{0, -1, 6, 8, 10, 5, 7, 9, -1, 12, 14, 16, 11, 13, 15, 1, 2, 3, 4, -1, -1, -1, -1, -1, -1},
+	{{1, 6, 5}, {8, 12, 11}},
+};
+
+void SkeletonConverter::convert(Pose& pose, const SkeletonMapping& mapping) {
+	if (pose.isEmpty()) return;
+	Pose source = pose;
+	pose.clearJoints();
+	int typeNum = static_cast<int>(mapping.jointMapping.size());
+	for (int type = 0; type < typeNum; ++type) {
+		int mappingType = mapping.jointMapping[type];
+		if (mappingType != -1 && source.hasJoint(mappingType)) {
+			pose.setJoint(type, source.jointPos[mappingType]);
+		}
+	}
+	for (auto& midpoint : mapping.midpoints) {
+		if (source.hasJoint(midpoint.sourceA) && source.hasJoint(midpoint.sourceB)) {
+			pose.setJoint(midpoint.type, (source.jointPos[midpoint.sourceA] + source.jointPos[midpoint.sourceB]) * 0.5);
+		}
+	}
+}
+
+void SkeletonConverter::convert(MultiPersonPoses& multiPersonPoses, const SkeletonMapping& mapping) {
+	int frameNum = static_cast<int>(multiPersonPoses.size());
+	Parallel::forEach(0, frameNum, [&](int frame, int) -> void {
+		for (auto& pose : multiPersonPoses[frame]) convert(pose, mapping);
+	});
+}
+
+void SkeletonConverter::shelfToBody25(MultiPersonPoses& multiPersonPoses) {
+	convert(multiPersonPoses, SHELF_TO_BODY25);
+}
+
+void SkeletonConverter::skel19ToBody25(MultiPersonPoses& multiPersonPoses) {
+	convert(multiPersonPoses, SKEL19_TO_BODY25);
+}
+
+void SkeletonConverter::coco17ToBody25(MultiPersonPoses& multiPersonPoses) {
+	convert(multiPersonPoses, COCO17_TO_BODY25);
+}
+
+void SkeletonConverter::correctShelfAtBody25(MultiPersonPose& multiPersonPose) {
+	for (auto& pose : multiPersonPose) {
+		Ink::Vec3 faceDir = (pose.jointPos[1] - pose.jointPos[8])
+			.cross(pose.jointPos[2] - pose.jointPos[5]).normalize();
+		Ink::Vec3 zDir = {0, 0, 1};
+		Ink::Vec3 shoulderCenter = (pose.jointPos[2] + pose.jointPos[5]) * 0.5f;
+		Ink::Vec3 headCenter = (pose.jointPos[17] + pose.jointPos[18]) * 0.5f;
+		
+		if (pose.hasJoint(17) ^ pose.hasJoint(18)) {
+			Ink::Vec3 ear;
+			if (pose.hasJoint(17)) ear = pose.jointPos[17];
+			if (pose.hasJoint(18)) ear = pose.jointPos[18];
+			Ink::Vec3 v1 = pose.jointPos[0] - shoulderCenter;
+			Ink::Vec3 v2 = {0, 0, 1};
+			Ink::Vec3 vn = v1.cross(v2).normalize();
+			headCenter = ear - (ear - shoulderCenter).dot(vn) * vn;
+		}
+		
+		if (pose.hasJoint(2) && pose.hasJoint(5)) {
+			pose.jointPos[1] = shoulderCenter + (headCenter - shoulderCenter) * 0.5f;
+			pose.jointPos[0] = pose.jointPos[1] + faceDir * 0.125f + zDir * 0.145f;
+		}
+		
+//		std::cout << (headCenter - shoulderCenter).normalize().dot({0, 0, 1}) << std::endl;
+		
+//		Ink::Vec3 coco0 = pose.jointPos[0];
+//		Ink::Vec3 neck = (pose.jointPos[5] + pose.jointPos[2]) / 2;
+//		Ink::Vec3 head_bottom = (neck + pose.jointPos[0]) / 2;
+//		Ink::Vec3 head_center = (pose.jointPos[17] + pose.jointPos[18]) / 2;
+//		Ink::Vec3 head_top = head_bottom + (head_center - head_bottom) * 2;
+//
+//		pose.jointPos[1] = (pose.jointPos[2] + pose.jointPos[5]) / 2;
+//		pose.jointPos[0] = pose.jointPos[1] + (coco0 - pose.jointPos[1]) * Ink::Vec3(0.78, 0.5, 1.5);
+//		pose.jointPos[1] = pose.jointPos[1] + (coco0 - pose.jointPos[1]) * Ink::Vec3(0.3, 0.4, 0.6);
+	}
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Views.h"
+
+#include <vector>
+
+/* Declarative joint remapping from one skeleton layout to another */
+struct SkeletonMapping {
+	struct Midpoint {
+		int type;
+		int sourceA;
+		int sourceB;
+	};
+	
+	/* source joint type of each target type, -1 if the target has no source */
+	std::vector<int> jointMapping;
+	
+	/* target joints synthesized from two source joints */
+	std::vector<Midpoint> midpoints;
+};
+
+class SkeletonConverter {
+public:
+	static const SkeletonMapping SHELF_TO_BODY25;
+	
+	static const SkeletonMapping SKEL19_TO_BODY25;
+	
+	static const SkeletonMapping COCO17_TO_BODY25;
+	
+	static void convert(Pose& pose, const SkeletonMapping& mapping);
+	
+	/* converts all poses in place, frames are processed in parallel */
+	static void convert(MultiPersonPoses& multiPersonPoses, const SkeletonMapping& mapping);
+	
+	static void shelfToBody25(MultiPersonPoses& multiPersonPoses);
+	
+	static void skel19ToBody25(MultiPersonPoses& multiPersonPoses);
+	
+	static void coco17ToBody25(MultiPersonPoses& multiPersonPoses);
+	
+	static void correctShelfAtBody25(MultiPersonPose& multiPersonPose);
+};
@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SweepRunner.h"
+
+#include "Parallel.h"
+#include "QuickPose.h"
+
+#include "fmt/format.h"
+
+#include <chrono>
+
+std::vector<SweepParameters> SweepGrid::expand() const {
+	std::vector<SweepParameters> parametersList;
+	for (float maxEpipolarDistance : maxEpipolarDistances) {
+		for (int maxClusterNum : maxClusterNums) {
+			for (int maxPersonNum : maxPersonNums) {
+				for (float minAffinity : minAffinities) {
+					for (float boneLengthMargin : boneLengthMargins) {
+						SweepParameters parameters;
+						parameters.maxEpipolarDistance = maxEpipolarDistance;
+						parameters.maxClusterNum = maxClusterNum;
+						parameters.maxPersonNum = maxPersonNum;
+						parameters.minAffinity = minAffinity;
+						parameters.boneLengthMargin = boneLengthMargin;
+						parametersList.emplace_back(parameters);
+					}
+				}
+			}
+		}
+	}
+	return parametersList;
+}
+
+void SweepRunner::setDataset(MultiViews&& multiviews) {
+	this->multiviews = std::move(multiviews);
+	
+	/* the ray distances do not depend on any parameter, compute them once unless the frames come with them */
+	Parallel::forEach(0, static_cast<int>(this->multiviews.size()), [&](int frame, int) -> void {
+		if (!this->multiviews[frame].hasEpipolarDistances(EpipolarMetric::RAY)) {
+			this->multiviews[frame].computeEpipolarDistances();
+		}
+	});
+}
+
+void SweepRunner::setGroundTruth(const MultiPersonPoses& multiPersonPosesGT, int offsetGT) {
+	this->multiPersonPosesGT = multiPersonPosesGT;
+	this->offsetGT = offsetGT;
+}
+
+void SweepRunner::setBoneConstraints(const BoneConstraints& boneConstraints) {
+	this->boneConstraints = boneConstraints;
+}
+
+void SweepRunner::setEvaluator(const Evaluator& evaluator) {
+	this->evaluator = evaluator;
+}
+
+void SweepRunner::setPostProcess(const PostProcess& postProcess) {
+	this->postProcess = postProcess;
+}
+
+std::vector<SweepResult> SweepRunner::run(const SweepGrid& grid) const {
+	auto parametersList = grid.expand();
+	int configNum = static_cast<int>(parametersList.size());
+	
+	/* one configuration at a time, so each latency is measured on an otherwise idle machine */
+	std::vector<SweepResult> results(configNum);
+	for (int config = 0; config < configNum; ++config) {
+		results[config] = run(parametersList[config]);
+	}
+	
+	/* a configuration is on the front if no faster configuration is at least as accurate */
+	std::vector<int> order(configNum);
+	for (int config = 0; config < configNum; ++config) order[config] = config;
+	std::sort(order.begin(), order.end(), [&](int config1, int config2) -> bool {
+		if (results[config1].latency != results[config2].latency) {
+			return results[config1].latency < results[config2].latency;
+		}
+		return results[config1].PCP > results[config2].PCP;
+	});
+	float bestPCP = -1;
+	for (int config : order) {
+		if (results[config].PCP > bestPCP) {
+			results[config].isPareto = true;
+			bestPCP = results[config].PCP;
+		}
+	}
+	
+	std::vector<SweepResult> sortedResults;
+	sortedResults.reserve(configNum);
+	for (int config : order) sortedResults.emplace_back(results[config]);
+	return sortedResults;
+}
+
+std::string SweepRunner::toParetoTable(const std::vector<SweepResult>& results) {
+	std::string table = fmt::format("{:>6} | {:>9} | {:>9} | {:>9} | {:>9} | {:>7} | {:>7} | {:>7} | {:>7} | {:>10}\n",
+									"Pareto", "Epipolar", "Clusters", "Persons", "Affinity", "Margin",
+									"PCP", "MPJPE", "PA", "Latency/ms");
+	for (auto& result : results) {
+		auto& parameters = result.parameters;
+		table += fmt::format("{:>6} | {:>9.4f} | {:>9} | {:>9} | {:>9.5f} | {:>7.3f} | {:>7.4f} | {:>7.4f} | {:>7.4f} | {:>10.3f}\n",
+							 result.isPareto ? "*" : "", parameters.maxEpipolarDistance, parameters.maxClusterNum,
+							 parameters.maxPersonNum, parameters.minAffinity, parameters.boneLengthMargin,
+							 result.PCP, result.MPJPE, result.PAMPJPE, result.latency);
+	}
+	return table;
+}
+
+SweepResult SweepRunner::run(const SweepParameters& parameters) const {
+	QuickPose quickpose;
+	quickpose.initBody25();
+	quickpose.setMaxEpipolarDistance(parameters.maxEpipolarDistance);
+	quickpose.setMaxClusterNum(parameters.maxClusterNum);
+	quickpose.setMaxPersonNum(parameters.maxPersonNum);
+	quickpose.setMinAffinity(parameters.minAffinity);
+	BoneConstraints constraints = boneConstraints;
+	constraints.widen(parameters.boneLengthMargin);
+	quickpose.setBoneConstraints(constraints);
+	
+	SweepResult result;
+	result.parameters = parameters;
+	
+	Evaluation evaluation;
+	double totalTime = 0;
+	long long frameNumGT = std::max<long long>(0, static_cast<long long>(multiPersonPosesGT.size()) - offsetGT);
+	int frameNum = static_cast<int>(std::min(static_cast<long long>(multiviews.size()), frameNumGT));
+	for (int frame = 0; frame < frameNum; ++frame) {
+		auto start = std::chrono::steady_clock::now();
+		auto multiPersonPose = quickpose.compute(multiviews[frame]);
+		auto end = std::chrono::steady_clock::now();
+		totalTime += std::chrono::duration<double, std::milli>(end - start).count();
+		
+		if (postProcess) postProcess(multiPersonPose);
+		evaluation.merge(evaluator.evaluate(multiPersonPosesGT[frame + offsetGT], multiPersonPose));
+	}
+	
+	result.PCP = evaluation.getPCP();
+	result.MPJPE = evaluation.getMPJPE();
+	result.PAMPJPE = evaluation.getPAMPJPE();
+	result.latency = frameNum == 0 ? 0 : totalTime / frameNum;
+	return result;
+}
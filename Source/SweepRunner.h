@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "BoneConstraints.h"
+#include "Evaluation.h"
+
+#include <functional>
+
+class SweepParameters {
+public:
+	float maxEpipolarDistance = 0.1f;
+	
+	int maxClusterNum = 100000;
+	
+	int maxPersonNum = 10;
+	
+	float minAffinity = 0.0001f;
+	
+	float boneLengthMargin = 0.1f;
+	
+	explicit SweepParameters() = default;
+};
+
+class SweepGrid {
+public:
+	std::vector<float> maxEpipolarDistances = {0.1f};
+	
+	std::vector<int> maxClusterNums = {100000};
+	
+	std::vector<int> maxPersonNums = {10};
+	
+	std::vector<float> minAffinities = {0.0001f};
+	
+	std::vector<float> boneLengthMargins = {0.1f};
+	
+	explicit SweepGrid() = default;
+	
+	std::vector<SweepParameters> expand() const;
+};
+
+class SweepResult {
+public:
+	SweepParameters parameters;
+	
+	float PCP = 0;
+	
+	float MPJPE = 0;
+	
+	float PAMPJPE = 0;
+	
+	double latency = 0;
+	
+	bool isPareto = false;
+	
+	explicit SweepResult() = default;
+};
+
+class SweepRunner {
+public:
+	using PostProcess = std::function<void(MultiPersonPose&)>;
+	
+	explicit SweepRunner() = default;
+	
+	void setDataset(MultiViews&& multiviews);
+	
+	void setGroundTruth(const MultiPersonPoses& multiPersonPosesGT, int offsetGT = 0);
+	
+	/* widened by each configuration's bone length margin */
+	void setBoneConstraints(const BoneConstraints& boneConstraints);
+	
+	void setEvaluator(const Evaluator& evaluator);
+	
+	void setPostProcess(const PostProcess& postProcess);
+	
+	std::vector<SweepResult> run(const SweepGrid& grid) const;
+	
+	static std::string toParetoTable(const std::vector<SweepResult>& results);
+	
+private:
+	int offsetGT = 0;
+	
+	MultiViews multiviews;
+	
+	MultiPersonPoses multiPersonPosesGT;
+	
+	BoneConstraints boneConstraints;
+	
+	Evaluator evaluator;
+	
+	PostProcess postProcess;
+	
+	SweepResult run(const SweepParameters& parameters) const;
+};
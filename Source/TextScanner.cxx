@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TextScanner.h"
+
+#include <charconv>
+
+TextScanner::TextScanner(const char* begin, const char* end) : cursor(begin), end(end) {}
+
+bool TextScanner::isEnd() {
+	skipSpaces();
+	return cursor == end;
+}
+
+std::string_view TextScanner::nextToken() {
+	skipSpaces();
+	const char* begin = cursor;
+	while (cursor != end && static_cast<unsigned char>(*cursor) > ' ') ++cursor;
+	return std::string_view(begin, cursor - begin);
+}
+
+bool TextScanner::nextInt(int& value) {
+	skipSpaces();
+	if (cursor != end && *cursor == '+') ++cursor;
+	auto [next, error] = std::from_chars(cursor, end, value);
+	if (error != std::errc()) return false;
+	cursor = next;
+	return true;
+}
+
+bool TextScanner::nextFloat(float& value) {
+	skipSpaces();
+	if (cursor != end && *cursor == '+') ++cursor;
+	auto [next, error] = std::from_chars(cursor, end, value);
+	if (error != std::errc()) return false;
+	cursor = next;
+	return true;
+}
+
+void TextScanner::skipLine() {
+	while (cursor != end && *cursor != '\n') ++cursor;
+	if (cursor != end) ++cursor;
+}
+
+void TextScanner::skipSpaces() {
+	while (cursor != end && static_cast<unsigned char>(*cursor) <= ' ') ++cursor;
+}
@@ -24,7 +24,29 @@
 
 #include "MathUtils.h"
 
-constexpr unsigned long long I32 = 1ull << 32;
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define VIEWS_USE_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define VIEWS_USE_NEON
+#endif
+
+static_assert(sizeof(Ink::Vec2) == 2 * sizeof(float), "Ink::Vec2 must be tightly packed");
+
+static size_t alignArena(size_t size) {
+	return (size + 15) & ~static_cast<size_t>(15);
+}
+
+/* rounds to the nearest fp16, the inverse of PAFRow::getValue for values in [0, 65504] */
+static uint16_t toHalf(float value) {
+	float scaled = std::min(std::max(value, 0.f), 65504.f) * 0x1p-112f;
+	uint32_t bits;
+	std::memcpy(&bits, &scaled, sizeof(bits));
+	return static_cast<uint16_t>((bits + 0x1000) >> 13);
+}
 
 void Camera::computePos() {
 	pos = -R.transpose() * t;
@@ -38,41 +60,509 @@ Ink::Ray Camera::computeRay(const Ink::Vec2& uv) const {
 	return Ink::Ray(pos, Ink::Vec3(-RtKi * Ink::Vec3(uv, 1.f)).normalize());
 }
 
-float View::getPAF(const Joint& joint1, const Joint& joint2) const {
-	if (PAFs.count(joint1.ID + joint2.ID * I32) != 0) {
-		return PAFs.at(joint1.ID + joint2.ID * I32);
+void Camera::computeDirections(const Ink::Vec2* uvs, size_t size, float* x, float* y, float* z) const {
+	const float* m[3] = {RtKi[0], RtKi[1], RtKi[2]};
+	const float* uvData = reinterpret_cast<const float*>(uvs);
+	size_t i = 0;
+	
+#if defined(VIEWS_USE_SSE)
+	__m128 m00 = _mm_set1_ps(-m[0][0]), m01 = _mm_set1_ps(-m[0][1]), m02 = _mm_set1_ps(-m[0][2]);
+	__m128 m10 = _mm_set1_ps(-m[1][0]), m11 = _mm_set1_ps(-m[1][1]), m12 = _mm_set1_ps(-m[1][2]);
+	__m128 m20 = _mm_set1_ps(-m[2][0]), m21 = _mm_set1_ps(-m[2][1]), m22 = _mm_set1_ps(-m[2][2]);
+	for (; i + 4 <= size; i += 4) {
+		__m128 uv01 = _mm_loadu_ps(uvData + i * 2);
+		__m128 uv23 = _mm_loadu_ps(uvData + i * 2 + 4);
+		__m128 u = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 v = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 dx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, u), _mm_mul_ps(m01, v)), m02);
+		__m128 dy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, u), _mm_mul_ps(m11, v)), m12);
+		__m128 dz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, u), _mm_mul_ps(m21, v)), m22);
+		__m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		_mm_storeu_ps(x + i, _mm_div_ps(dx, l));
+		_mm_storeu_ps(y + i, _mm_div_ps(dy, l));
+		_mm_storeu_ps(z + i, _mm_div_ps(dz, l));
+	}
+#elif defined(VIEWS_USE_NEON)
+	float32x4_t m00 = vdupq_n_f32(-m[0][0]), m01 = vdupq_n_f32(-m[0][1]), m02 = vdupq_n_f32(-m[0][2]);
+	float32x4_t m10 = vdupq_n_f32(-m[1][0]), m11 = vdupq_n_f32(-m[1][1]), m12 = vdupq_n_f32(-m[1][2]);
+	float32x4_t m20 = vdupq_n_f32(-m[2][0]), m21 = vdupq_n_f32(-m[2][1]), m22 = vdupq_n_f32(-m[2][2]);
+	for (; i + 4 <= size; i += 4) {
+		float32x4x2_t uv = vld2q_f32(uvData + i * 2);
+		float32x4_t dx = vmlaq_f32(vmlaq_f32(m02, m00, uv.val[0]), m01, uv.val[1]);
+		float32x4_t dy = vmlaq_f32(vmlaq_f32(m12, m10, uv.val[0]), m11, uv.val[1]);
+		float32x4_t dz = vmlaq_f32(vmlaq_f32(m22, m20, uv.val[0]), m21, uv.val[1]);
+		float32x4_t l = vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz));
+		vst1q_f32(x + i, vdivq_f32(dx, l));
+		vst1q_f32(y + i, vdivq_f32(dy, l));
+		vst1q_f32(z + i, vdivq_f32(dz, l));
+	}
+#endif
+	
+	for (; i < size; ++i) {
+		float u = uvData[i * 2];
+		float v = uvData[i * 2 + 1];
+		float dx = -(m[0][0] * u + m[0][1] * v + m[0][2]);
+		float dy = -(m[1][0] * u + m[1][1] * v + m[1][2]);
+		float dz = -(m[2][0] * u + m[2][1] * v + m[2][2]);
+		float l = sqrtf(dx * dx + dy * dy + dz * dz);
+		x[i] = dx / l;
+		y[i] = dy / l;
+		z[i] = dz / l;
+	}
+}
+
+void Session::setSkeleton(int typeNum, const std::vector<int>& boneA, const std::vector<int>& boneB) {
+	this->typeNum = typeNum;
+	this->boneNum = static_cast<int>(boneA.size());
+	this->boneA = boneA;
+	this->boneB = boneB;
+	bones.assign(typeNum * typeNum, -1);
+	for (int bone = 0; bone < boneNum; ++bone) {
+		bones[boneA[bone] * typeNum + boneB[bone]] = bone;
+		bones[boneB[bone] * typeNum + boneA[bone]] = bone;
+	}
+}
+
+int Session::getBone(int typeA, int typeB) const {
+	return bones[typeA * typeNum + typeB];
+}
+
+void Session::computeGeometry() {
+	viewPairs.assign(viewNum * viewNum, ViewPair());
+	for (int viewA = 0; viewA < viewNum; ++viewA) {
+		for (int viewB = 0; viewB < viewNum; ++viewB) {
+			if (viewA == viewB) continue;
+			const Camera& cameraA = *cameras[viewA];
+			const Camera& cameraB = *cameras[viewB];
+			auto& viewPair = viewPairs[viewA * viewNum + viewB];
+			viewPair.baseline = cameraA.pos - cameraB.pos;
+			
+			/* F = Kb^-T [t]x R Ka^-1 with the relative pose of B in A */
+			Ink::Mat3 R = cameraB.R * cameraA.R.transpose();
+			Ink::Vec3 t = cameraB.t - Ink::Vec3(R * cameraA.t);
+			Ink::Mat3 tx = {
+				0, -t.z, t.y,
+				t.z, 0, -t.x,
+				-t.y, t.x, 0,
+			};
+			viewPair.fundamental = Ink::inverse_3x3(cameraB.K).transpose() * tx * R * Ink::inverse_3x3(cameraA.K);
+		}
+	}
+}
+
+const ViewPair& Session::getViewPair(int viewA, int viewB) const {
+	return viewPairs[viewA * viewNum + viewB];
+}
+
+MultiView::MultiView(const std::shared_ptr<const Session>& session, const std::vector<int>& jointNums) :
+session(session) {
+	int viewNum = session->viewNum;
+	int typeNum = session->typeNum;
+	int boneNum = session->boneNum;
+	
+	int jointOffsetNum = typeNum * viewNum + 1;
+	int PAFOffsetNum = viewNum * boneNum + 1;
+	
+	/* joints are stored type by type, so all the candidates of a type are contiguous */
+	std::vector<int> jointOffsets(jointOffsetNum, 0);
+	for (int type = 0; type < typeNum; ++type) {
+		for (int view = 0; view < viewNum; ++view) {
+			int index = type * viewNum + view;
+			jointOffsets[index + 1] = jointOffsets[index] + jointNums[view * typeNum + type];
+		}
+	}
+	totalJointNum = jointOffsets.back();
+	
+	std::vector<int> PAFOffsets(PAFOffsetNum, 0);
+	for (int view = 0; view < viewNum; ++view) {
+		for (int bone = 0; bone < boneNum; ++bone) {
+			int index = view * boneNum + bone;
+			int jointNumA = jointNums[view * typeNum + session->boneA[bone]];
+			int jointNumB = jointNums[view * typeNum + session->boneB[bone]];
+			PAFOffsets[index + 1] = PAFOffsets[index] + jointNumA * jointNumB;
+		}
 	}
-	return PAFs.at(joint1.ID * I32 + joint2.ID);
+	
+	UVOffset = alignArena((jointOffsetNum + PAFOffsetNum) * sizeof(int));
+	confOffset = UVOffset + alignArena(totalJointNum * sizeof(Ink::Vec2));
+	directionOffset = confOffset + alignArena(totalJointNum * sizeof(float));
+	PAFOffset = directionOffset + alignArena(totalJointNum * sizeof(float)) * 3;
+	arena.resize(PAFOffset + PAFOffsets.back() * sizeof(float));
+	
+	std::copy(jointOffsets.begin(), jointOffsets.end(), reinterpret_cast<int*>(arena.data()));
+	std::copy(PAFOffsets.begin(), PAFOffsets.end(), reinterpret_cast<int*>(arena.data()) + jointOffsetNum);
 }
 
-void View::setPAF(const Joint& joint1, const Joint& joint2, float value) {
-	PAFs.insert_or_assign(joint1.ID + joint2.ID * I32, value);
+int MultiView::getViewNum() const {
+	return session->viewNum;
 }
 
-void MultiView::computeEpipolar(float maxDistance) {
-	int viewNum = static_cast<int>(views.size());
-	int jointTypeNum = static_cast<int>(views[0].joints.size());
-	for (int viewIA = 0; viewIA < viewNum; ++viewIA) {
-		for (int viewIB = viewIA + 1; viewIB < viewNum; ++viewIB) {
-			for (int jointType = 0; jointType < jointTypeNum; ++jointType) {
-				for (auto& jointA : views[viewIA].joints[jointType]) {
-					for (auto& jointB : views[viewIB].joints[jointType]) {
-						float distance = MathUtils::computeRayDistance(jointA.ray, jointB.ray);
-						setEpipolar(jointA, jointB, 1.f - distance / maxDistance);
+int MultiView::getTypeNum() const {
+	return session->typeNum;
+}
+
+const Camera& MultiView::getCamera(int view) const {
+	return *session->cameras[view];
+}
+
+int MultiView::getJointNum(int view, int type) const {
+	int index = type * session->viewNum + view;
+	return getJointOffsets()[index + 1] - getJointOffsets()[index];
+}
+
+int MultiView::getJointIndex(int view, int type, int choice) const {
+	return getJointOffsets()[type * session->viewNum + view] + choice;
+}
+
+int MultiView::getTotalJointNum() const {
+	return totalJointNum;
+}
+
+Ink::Vec2* MultiView::getUVs(int view, int type) {
+	return reinterpret_cast<Ink::Vec2*>(arena.data() + UVOffset) + getJointIndex(view, type, 0);
+}
+
+const Ink::Vec2* MultiView::getUVs(int view, int type) const {
+	return reinterpret_cast<const Ink::Vec2*>(arena.data() + UVOffset) + getJointIndex(view, type, 0);
+}
+
+float* MultiView::getConfs(int view, int type) {
+	return reinterpret_cast<float*>(arena.data() + confOffset) + getJointIndex(view, type, 0);
+}
+
+const float* MultiView::getConfs(int view, int type) const {
+	return reinterpret_cast<const float*>(arena.data() + confOffset) + getJointIndex(view, type, 0);
+}
+
+float* MultiView::getPAFs(int view, int bone) {
+	return reinterpret_cast<float*>(arena.data() + PAFOffset) + getPAFOffsets()[view * session->boneNum + bone];
+}
+
+const float* MultiView::getPAFs(int view, int bone) const {
+	return reinterpret_cast<const float*>(arena.data() + PAFOffset) + getPAFOffsets()[view * session->boneNum + bone];
+}
+
+Ink::Vec3 MultiView::getDirection(int view, int type, int choice) const {
+	int index = getJointIndex(view, type, choice);
+	return {getDirections(0)[index], getDirections(1)[index], getDirections(2)[index]};
+}
+
+Ink::Ray MultiView::getRay(int view, int type, int choice) const {
+	return Ink::Ray(getCamera(view).pos, getDirection(view, type, choice));
+}
+
+float MultiView::getPAF(int view, int typeA, int choiceA, int typeB, int choiceB) const {
+	if (isCompressed) {
+		PAFRow row = getPAFRow(view, typeA, choiceA, typeB);
+		for (int index = 0; index < row.size; ++index) {
+			if (row.choices[index] == choiceB) return row.getValue(index);
+		}
+		return 0.f;
+	}
+	
+	int bone = session->getBone(typeA, typeB);
+	if (bone == -1) return 0.f;
+	if (session->boneA[bone] == typeA) {
+		return getPAFs(view, bone)[choiceA * getJointNum(view, typeB) + choiceB];
+	}
+	return getPAFs(view, bone)[choiceB * getJointNum(view, typeA) + choiceA];
+}
+
+void MultiView::setPAF(int view, int typeA, int choiceA, int typeB, int choiceB, float value) {
+	int bone = session->getBone(typeA, typeB);
+	if (bone == -1) return;
+	if (session->boneA[bone] == typeA) {
+		getPAFs(view, bone)[choiceA * getJointNum(view, typeB) + choiceB] = value;
+	} else {
+		getPAFs(view, bone)[choiceB * getJointNum(view, typeA) + choiceA] = value;
+	}
+}
+
+void MultiView::compressPAFs(float threshold, bool isHalf) {
+	if (isCompressed) return;
+	
+	int viewNum = session->viewNum;
+	int boneNum = session->boneNum;
+	PAFBlockRows.assign(viewNum * boneNum * 2, 0);
+	PAFRowStarts.clear();
+	PAFChoices.clear();
+	PAFValues.clear();
+	PAFHalfValues.clear();
+	
+	for (int view = 0; view < viewNum; ++view) {
+		for (int bone = 0; bone < boneNum; ++bone) {
+			int jointNumA = getJointNum(view, session->boneA[bone]);
+			int jointNumB = getJointNum(view, session->boneB[bone]);
+			const float* PAFs = getPAFs(view, bone);
+			for (int direction = 0; direction < 2; ++direction) {
+				int rowNum = direction == 0 ? jointNumA : jointNumB;
+				int columnNum = direction == 0 ? jointNumB : jointNumA;
+				PAFBlockRows[(view * boneNum + bone) * 2 + direction] = static_cast<int>(PAFRowStarts.size());
+				for (int row = 0; row < rowNum; ++row) {
+					PAFRowStarts.emplace_back(static_cast<int>(PAFChoices.size()));
+					for (int column = 0; column < columnNum; ++column) {
+						float value = direction == 0 ? PAFs[row * jointNumB + column] : PAFs[column * jointNumB + row];
+						if (value < threshold) continue;
+						PAFChoices.emplace_back(static_cast<uint16_t>(column));
+						if (isHalf) {
+							PAFHalfValues.emplace_back(toHalf(value));
+						} else {
+							PAFValues.emplace_back(value);
+						}
+					}
+				}
+			}
+		}
+	}
+	PAFRowStarts.emplace_back(static_cast<int>(PAFChoices.size()));
+	
+	/* the dense blocks are the tail of the arena */
+	arena.resize(PAFOffset);
+	arena.shrink_to_fit();
+	PAFChoices.shrink_to_fit();
+	PAFValues.shrink_to_fit();
+	PAFHalfValues.shrink_to_fit();
+	
+	isCompressed = true;
+	isHalfPAF = isHalf;
+	PAFThreshold = threshold;
+}
+
+bool MultiView::isPAFCompressed() const {
+	return isCompressed;
+}
+
+PAFRow MultiView::getPAFRow(int view, int typeA, int choiceA, int typeB) const {
+	PAFRow row;
+	int bone = session->getBone(typeA, typeB);
+	if (bone == -1) return row;
+	int direction = session->boneA[bone] == typeA ? 0 : 1;
+	int rowIndex = PAFBlockRows[(view * session->boneNum + bone) * 2 + direction] + choiceA;
+	int start = PAFRowStarts[rowIndex];
+	row.size = PAFRowStarts[rowIndex + 1] - start;
+	row.choices = PAFChoices.data() + start;
+	if (isHalfPAF) {
+		row.halfValues = PAFHalfValues.data() + start;
+	} else {
+		row.values = PAFValues.data() + start;
+	}
+	return row;
+}
+
+size_t MultiView::getByteSize() const {
+	return arena.capacity() + PAFBlockRows.capacity() * sizeof(int) + PAFRowStarts.capacity() * sizeof(int) +
+		   PAFChoices.capacity() * sizeof(uint16_t) + PAFValues.capacity() * sizeof(float) +
+		   PAFHalfValues.capacity() * sizeof(uint16_t) + epipolarOffsets.capacity() * sizeof(int) +
+		   epipolarDistances.capacity() * sizeof(float);
+}
+
+void MultiView::computeDirections() {
+	int viewNum = session->viewNum;
+	int typeNum = session->typeNum;
+	float* x = getDirections(0);
+	float* y = getDirections(1);
+	float* z = getDirections(2);
+	for (int type = 0; type < typeNum; ++type) {
+		for (int view = 0; view < viewNum; ++view) {
+			int start = getJointIndex(view, type, 0);
+			getCamera(view).computeDirections(getUVs(view, type), getJointNum(view, type),
+											  x + start, y + start, z + start);
+		}
+	}
+}
+
+void MultiView::computeEpipolarDistances(EpipolarMetric metric) {
+	int viewNum = session->viewNum;
+	int typeNum = session->typeNum;
+	const int* jointOffsets = getJointOffsets();
+	resizeEpipolarDistances();
+	epipolarMetric = metric;
+	
+	const float* x = getDirections(0);
+	const float* y = getDirections(1);
+	const float* z = getDirections(2);
+	for (int type = 0; type < typeNum; ++type) {
+		int typeStart = jointOffsets[type * viewNum];
+		int jointNum = jointOffsets[(type + 1) * viewNum] - typeStart;
+		float* block = epipolarDistances.data() + epipolarOffsets[type];
+		for (int viewA = 0; viewA < viewNum; ++viewA) {
+			for (int viewB = viewA + 1; viewB < viewNum; ++viewB) {
+				const ViewPair& viewPair = session->getViewPair(viewA, viewB);
+				int startA = jointOffsets[type * viewNum + viewA];
+				int startB = jointOffsets[type * viewNum + viewB];
+				int jointNumA = getJointNum(viewA, type);
+				int jointNumB = getJointNum(viewB, type);
+				const Ink::Vec2* uvsA = getUVs(viewA, type);
+				const Ink::Vec2* uvsB = getUVs(viewB, type);
+				for (int jointIA = 0; jointIA < jointNumA; ++jointIA) {
+					int indexA = startA + jointIA;
+					int localA = indexA - typeStart;
+					float* row = block + localA * jointNum + (startB - typeStart);
+					if (metric == EpipolarMetric::PIXEL) {
+						MathUtils::computeEpipolarLineDistances(viewPair.fundamental, uvsA[jointIA], uvsB, jointNumB, row);
+					} else {
+						MathUtils::computeRayDistances(viewPair.baseline, {x[indexA], y[indexA], z[indexA]},
+													   x + startB, y + startB, z + startB, jointNumB, row);
+					}
+					for (int jointIB = 0; jointIB < jointNumB; ++jointIB) {
+						block[(startB - typeStart + jointIB) * jointNum + localA] = row[jointIB];
+					}
+				}
+			}
+		}
+	}
+}
+
+bool MultiView::hasEpipolarDistances(EpipolarMetric metric) const {
+	return !epipolarOffsets.empty() && epipolarMetric == metric;
+}
+
+MultiView MultiView::selectJoints(const std::vector<unsigned char>& isKept) const {
+	int viewNum = session->viewNum;
+	int typeNum = session->typeNum;
+	int boneNum = session->boneNum;
+	
+	/* kept joints keep their order, so a joint's new choice is the number of kept joints before it */
+	std::vector<int> newChoices(totalJointNum, -1);
+	std::vector<int> jointNums(viewNum * typeNum, 0);
+	for (int type = 0; type < typeNum; ++type) {
+		for (int view = 0; view < viewNum; ++view) {
+			int start = getJointIndex(view, type, 0);
+			int& jointNum = jointNums[view * typeNum + type];
+			for (int choice = 0; choice < getJointNum(view, type); ++choice) {
+				if (isKept[start + choice]) newChoices[start + choice] = jointNum++;
+			}
+		}
+	}
+	
+	MultiView multiview(session, jointNums);
+	multiview.timestamp = timestamp;
+	
+	const float* x = getDirections(0);
+	const float* y = getDirections(1);
+	const float* z = getDirections(2);
+	float* newX = multiview.getDirections(0);
+	float* newY = multiview.getDirections(1);
+	float* newZ = multiview.getDirections(2);
+	for (int type = 0; type < typeNum; ++type) {
+		for (int view = 0; view < viewNum; ++view) {
+			int start = getJointIndex(view, type, 0);
+			int newStart = multiview.getJointIndex(view, type, 0);
+			const Ink::Vec2* uvs = getUVs(view, type);
+			const float* confs = getConfs(view, type);
+			Ink::Vec2* newUVs = multiview.getUVs(view, type);
+			float* newConfs = multiview.getConfs(view, type);
+			for (int choice = 0; choice < getJointNum(view, type); ++choice) {
+				int newChoice = newChoices[start + choice];
+				if (newChoice == -1) continue;
+				newUVs[newChoice] = uvs[choice];
+				newConfs[newChoice] = confs[choice];
+				newX[newStart + newChoice] = x[start + choice];
+				newY[newStart + newChoice] = y[start + choice];
+				newZ[newStart + newChoice] = z[start + choice];
+			}
+		}
+	}
+	
+	for (int view = 0; view < viewNum; ++view) {
+		for (int bone = 0; bone < boneNum; ++bone) {
+			int typeA = session->boneA[bone];
+			int typeB = session->boneB[bone];
+			int startA = getJointIndex(view, typeA, 0);
+			int startB = getJointIndex(view, typeB, 0);
+			int jointNumA = getJointNum(view, typeA);
+			int jointNumB = getJointNum(view, typeB);
+			int newJointNumB = multiview.getJointNum(view, typeB);
+			const float* PAFs = isCompressed ? nullptr : getPAFs(view, bone);
+			float* newPAFs = multiview.getPAFs(view, bone);
+			for (int choiceA = 0; choiceA < jointNumA; ++choiceA) {
+				int newChoiceA = newChoices[startA + choiceA];
+				if (newChoiceA == -1) continue;
+				if (isCompressed) {
+					PAFRow row = getPAFRow(view, typeA, choiceA, typeB);
+					for (int index = 0; index < row.size; ++index) {
+						int newChoiceB = newChoices[startB + row.choices[index]];
+						if (newChoiceB == -1) continue;
+						newPAFs[newChoiceA * newJointNumB + newChoiceB] = row.getValue(index);
 					}
+					continue;
+				}
+				for (int choiceB = 0; choiceB < jointNumB; ++choiceB) {
+					int newChoiceB = newChoices[startB + choiceB];
+					if (newChoiceB == -1) continue;
+					newPAFs[newChoiceA * newJointNumB + newChoiceB] = PAFs[choiceA * jointNumB + choiceB];
 				}
 			}
 		}
 	}
+	
+	if (isCompressed) multiview.compressPAFs(PAFThreshold, isHalfPAF);
+	return multiview;
+}
+
+float MultiView::getEpipolarDistance(int type, int viewA, int choiceA, int viewB, int choiceB) const {
+	int typeStart = getJointOffsets()[type * session->viewNum];
+	int jointNum = getJointOffsets()[(type + 1) * session->viewNum] - typeStart;
+	int localA = getJointIndex(viewA, type, choiceA) - typeStart;
+	int localB = getJointIndex(viewB, type, choiceB) - typeStart;
+	return epipolarDistances[epipolarOffsets[type] + localA * jointNum + localB];
 }
 
-float MultiView::getEpipolar(const Joint& joint1, const Joint& joint2) const {
-	if (epipolars.count(joint1.ID + joint2.ID * I32) != 0) {
-		return epipolars.at(joint1.ID + joint2.ID * I32);
+size_t MultiView::getSerializedSize() const {
+	return arena.size() + epipolarDistances.size() * sizeof(float);
+}
+
+void MultiView::serialize(char* data) const {
+	std::memcpy(data, arena.data(), arena.size());
+	std::memcpy(data + arena.size(), epipolarDistances.data(), epipolarDistances.size() * sizeof(float));
+}
+
+bool MultiView::deserialize(const char* data, size_t size, EpipolarMetric metric) {
+	if (isCompressed) return false;
+	
+	/* the offsets heading the arena only match if the frame was constructed with the same joint numbers */
+	resizeEpipolarDistances();
+	if (size != getSerializedSize() || std::memcmp(arena.data(), data, UVOffset) != 0) {
+		epipolarOffsets.clear();
+		epipolarDistances.clear();
+		return false;
 	}
-	return epipolars.at(joint1.ID * I32 + joint2.ID);
+	
+	std::memcpy(arena.data(), data, arena.size());
+	std::memcpy(epipolarDistances.data(), data + arena.size(), epipolarDistances.size() * sizeof(float));
+	epipolarMetric = metric;
+	return true;
 }
 
-void MultiView::setEpipolar(const Joint& joint1, const Joint& joint2, float value) {
-	epipolars.insert_or_assign(joint1.ID + joint2.ID * I32, value);
+const int* MultiView::getJointOffsets() const {
+	return reinterpret_cast<const int*>(arena.data());
+}
+
+const int* MultiView::getPAFOffsets() const {
+	return getJointOffsets() + session->typeNum * session->viewNum + 1;
+}
+
+float* MultiView::getDirections(int axis) {
+	size_t stride = alignArena(totalJointNum * sizeof(float));
+	return reinterpret_cast<float*>(arena.data() + directionOffset + stride * axis);
+}
+
+const float* MultiView::getDirections(int axis) const {
+	size_t stride = alignArena(totalJointNum * sizeof(float));
+	return reinterpret_cast<const float*>(arena.data() + directionOffset + stride * axis);
+}
+
+void MultiView::resizeEpipolarDistances() {
+	int viewNum = session->viewNum;
+	int typeNum = session->typeNum;
+	const int* jointOffsets = getJointOffsets();
+	
+	/* a dense square block per joint type, indexed by the joint index within the type */
+	epipolarOffsets.resize(typeNum + 1);
+	epipolarOffsets[0] = 0;
+	for (int type = 0; type < typeNum; ++type) {
+		int jointNum = jointOffsets[(type + 1) * viewNum] - jointOffsets[type * viewNum];
+		epipolarOffsets[type + 1] = epipolarOffsets[type] + jointNum * jointNum;
+	}
+	epipolarDistances.resize(epipolarOffsets.back());
 }
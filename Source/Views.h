@@ -24,12 +24,10 @@
 
 #include "ink/Ink.h"
 
-struct Joint {
-	int ID = 0;
-	Ink::Ray ray;
-	Ink::Vec2 uv;
-	float conf = 0;
-};
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 class Camera {
 public:
@@ -48,53 +46,289 @@ public:
 	void computeRtKi();
 	
 	Ink::Ray computeRay(const Ink::Vec2& uv) const;
+	
+	void computeDirections(const Ink::Vec2* uvs, size_t size, float* x, float* y, float* z) const;
+};
+
+/* fixed geometry of an ordered pair of views, derived from the calibration */
+class ViewPair {
+public:
+	/* position of the first view minus position of the second */
+	Ink::Vec3 baseline;
+	
+	/* maps a pixel of the first view to its epipolar line in the second */
+	Ink::Mat3 fundamental;
+	
+	explicit ViewPair() = default;
+};
+
+enum class EpipolarMetric {
+	/* distance between the two back-projected rays, in world units */
+	RAY,
+	
+	/* symmetric distance from each pixel to the other's epipolar line, in pixels */
+	PIXEL,
 };
 
-class View {
+class Session {
 public:
-	std::shared_ptr<Camera> camera;
+	int viewNum = 0;
+	
+	int typeNum = 0;
 	
-	std::vector<std::vector<Joint> > joints;
+	int boneNum = 0;
 	
-	explicit View() = default;
+	std::vector<int> boneA;
 	
-	float getPAF(const Joint& joint1, const Joint& joint2) const;
+	std::vector<int> boneB;
 	
-	void setPAF(const Joint& joint1, const Joint& joint2, float value);
+	std::vector<std::shared_ptr<Camera> > cameras;
+	
+	explicit Session() = default;
+	
+	void setSkeleton(int typeNum, const std::vector<int>& boneA, const std::vector<int>& boneB);
+	
+	int getBone(int typeA, int typeB) const;
+	
+	/* call once the cameras are calibrated */
+	void computeGeometry();
+	
+	const ViewPair& getViewPair(int viewA, int viewB) const;
 	
 private:
-	std::unordered_map<unsigned long long, float> PAFs;
+	std::vector<int> bones;
+	
+	std::vector<ViewPair> viewPairs;
+};
+
+/* candidates of one joint type connected to a detection of another, as stored by a compressed frame */
+class PAFRow {
+public:
+	int size = 0;
+	
+	const uint16_t* choices = nullptr;
+	
+	/* one of the two is set, depending on the precision the frame was compressed with */
+	const float* values = nullptr;
+	
+	const uint16_t* halfValues = nullptr;
+	
+	explicit PAFRow() = default;
+	
+	float getValue(int index) const {
+		if (values != nullptr) return values[index];
+		
+		/* PAFs are never negative or huge, so the half shifted into a float only needs its exponent rebiased */
+		uint32_t bits = static_cast<uint32_t>(halfValues[index] & 0x7fff) << 13;
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value * 0x1p112f;
+	}
 };
 
 class MultiView {
 public:
-	std::vector<View> views;
+	std::shared_ptr<const Session> session;
+	
+	/* capture time in microseconds, set by live sources */
+	unsigned long long timestamp = 0;
 	
 	explicit MultiView() = default;
 	
-	void computeEpipolar(float maxDistance);
+	explicit MultiView(const std::shared_ptr<const Session>& session, const std::vector<int>& jointNums);
+	
+	int getViewNum() const;
+	
+	int getTypeNum() const;
+	
+	const Camera& getCamera(int view) const;
+	
+	int getJointNum(int view, int type) const;
+	
+	int getJointIndex(int view, int type, int choice) const;
+	
+	int getTotalJointNum() const;
+	
+	Ink::Vec2* getUVs(int view, int type);
+	
+	const Ink::Vec2* getUVs(int view, int type) const;
+	
+	float* getConfs(int view, int type);
+	
+	const float* getConfs(int view, int type) const;
+	
+	/* dense block of a bone, rows are the choices of boneA, only valid before compressPAFs */
+	float* getPAFs(int view, int bone);
+	
+	const float* getPAFs(int view, int bone) const;
+	
+	Ink::Vec3 getDirection(int view, int type, int choice) const;
+	
+	Ink::Ray getRay(int view, int type, int choice) const;
+	
+	float getPAF(int view, int typeA, int choiceA, int typeB, int choiceB) const;
+	
+	void setPAF(int view, int typeA, int choiceA, int typeB, int choiceB, float value);
+	
+	/**
+	 * Replaces the dense PAF blocks by rows holding only the entries at or
+	 * above threshold, in both directions of every bone, and frees the dense
+	 * blocks. Half precision stores the values as fp16. getPAF keeps working,
+	 * entries below the threshold read as 0.
+	 */
+	void compressPAFs(float threshold, bool isHalf = false);
+	
+	bool isPAFCompressed() const;
 	
-	float getEpipolar(const Joint& joint1, const Joint& joint2) const;
+	/* candidates of typeB connected to choiceA of typeA, only valid once compressed */
+	PAFRow getPAFRow(int view, int typeA, int choiceA, int typeB) const;
 	
-	void setEpipolar(const Joint& joint1, const Joint& joint2, float value);
+	/* bytes held by the frame, PAFs included */
+	size_t getByteSize() const;
+	
+	void computeDirections();
+	
+	void computeEpipolarDistances(EpipolarMetric metric = EpipolarMetric::RAY);
+	
+	bool hasEpipolarDistances(EpipolarMetric metric) const;
+	
+	/**
+	 * Copies the frame keeping only the joints flagged in isKept, indexed by
+	 * joint index. Directions and PAFs are carried over, epipolar distances
+	 * have to be computed again.
+	 */
+	MultiView selectJoints(const std::vector<unsigned char>& isKept) const;
+	
+	float getEpipolarDistance(int type, int viewA, int choiceA, int viewB, int choiceB) const;
+	
+	/* bytes written by serialize, the arena followed by the epipolar distances of a dense frame */
+	size_t getSerializedSize() const;
+	
+	void serialize(char* data) const;
+	
+	/**
+	 * Restores a frame written by serialize into one constructed with the
+	 * same joint numbers, so the session is not part of the data. Returns
+	 * false if the data does not match the frame's layout.
+	 */
+	bool deserialize(const char* data, size_t size, EpipolarMetric metric);
 	
 private:
-	std::unordered_map<unsigned long long, float> epipolars;
+	int totalJointNum = 0;
+	
+	size_t UVOffset = 0;
+	
+	size_t confOffset = 0;
+	
+	size_t directionOffset = 0;
+	
+	size_t PAFOffset = 0;
+	
+	std::vector<unsigned char> arena;
+	
+	bool isCompressed = false;
+	
+	bool isHalfPAF = false;
+	
+	float PAFThreshold = 0;
+	
+	/**
+	 * Compressed PAFs, one block of rows per view, bone and direction, where
+	 * direction 0 has a row per choice of boneA. Rows of consecutive blocks
+	 * are contiguous, so a row ends where the next one starts.
+	 */
+	std::vector<int> PAFBlockRows;
+	
+	std::vector<int> PAFRowStarts;
+	
+	std::vector<uint16_t> PAFChoices;
+	
+	std::vector<float> PAFValues;
+	
+	std::vector<uint16_t> PAFHalfValues;
+	
+	std::vector<int> epipolarOffsets;
+	
+	std::vector<float> epipolarDistances;
+	
+	EpipolarMetric epipolarMetric = EpipolarMetric::RAY;
+	
+	const int* getJointOffsets() const;
+	
+	const int* getPAFOffsets() const;
+	
+	float* getDirections(int axis);
+	
+	const float* getDirections(int axis) const;
+	
+	void resizeEpipolarDistances();
 };
 
 using MultiViews = std::vector<MultiView>;
 
-class Pose {
+/**
+ * Pose of one person with storage for N joint types, kept inline so a pose
+ * never allocates. Validity is a bitmask, missing joints are kept at the
+ * origin.
+ */
+template <int N>
+class BasicPose {
 public:
+	static_assert(N > 0 && N <= 64, "BasicPose supports up to 64 joint types");
+	
+	using Mask = std::conditional_t<(N <= 32), uint32_t, uint64_t>;
+	
+	static constexpr int JOINT_NUM = N;
+	
 	int ID = 0;
 	
-	std::vector<bool> hasJoint;
+	Mask jointMask = 0;
 	
-	std::vector<Ink::Vec3> jointPos;
+	std::array<Ink::Vec3, N> jointPos;
 	
-	explicit Pose() = default;
+	explicit BasicPose() = default;
+	
+	bool hasJoint(int type) const;
+	
+	void setJoint(int type, const Ink::Vec3& pos);
+	
+	void removeJoint(int type);
+	
+	void clearJoints();
+	
+	bool isEmpty() const;
 };
 
+template <int N>
+bool BasicPose<N>::hasJoint(int type) const {
+	return (jointMask >> type) & 1;
+}
+
+template <int N>
+void BasicPose<N>::setJoint(int type, const Ink::Vec3& pos) {
+	jointMask |= Mask(1) << type;
+	jointPos[type] = pos;
+}
+
+template <int N>
+void BasicPose<N>::removeJoint(int type) {
+	jointMask &= ~(Mask(1) << type);
+	jointPos[type] = Ink::Vec3();
+}
+
+template <int N>
+void BasicPose<N>::clearJoints() {
+	jointMask = 0;
+	jointPos.fill(Ink::Vec3());
+}
+
+template <int N>
+bool BasicPose<N>::isEmpty() const {
+	return jointMask == 0;
+}
+
+using Pose = BasicPose<25>;
+
 using MultiPersonPose = std::vector<Pose>;
  
 using MultiPersonPoses = std::vector<MultiPersonPose>;
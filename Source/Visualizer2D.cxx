@@ -34,16 +34,19 @@ cv::Scalar COLORS[4] = {
 };
 
 void Visualizer2D::visualize(const MultiPersonPose& multiPersonPose,
-							 const View& view, const std::string& imagePath) {
-	auto camera = view.camera;
+							 const MultiView& multiview, int view, const std::string& imagePath) {
+	auto camera = &multiview.getCamera(view);
 	auto image = cv::imread(imagePath);
 	
 	for (int type = 0; type < 25; ++type) {
-		for (auto& choice : view.joints[type]) {
+		int choiceNum = multiview.getJointNum(view, type);
+		const Ink::Vec2* uvs = multiview.getUVs(view, type);
+		const float* confs = multiview.getConfs(view, type);
+		for (int choice = 0; choice < choiceNum; ++choice) {
 			cv::Point point;
-			point.x = choice.uv.x;
-			point.y = choice.uv.y;
-			double green = choice.conf * 255;
+			point.x = uvs[choice].x;
+			point.y = uvs[choice].y;
+			double green = confs[choice] * 255;
 			cv::circle(image, point, 1, {0, green, 255}, 5);
 			cv::putText(image, std::to_string(type), point, cv::FONT_HERSHEY_SIMPLEX, 0.5, {0, green, 255});
 		}
@@ -54,10 +57,9 @@ void Visualizer2D::visualize(const MultiPersonPose& multiPersonPose,
 	for (auto& pose : multiPersonPose) {
 		auto color = COLORS[pose.ID];
 		
-		if (pose.hasJoint.empty()) continue;
-		size_t jointSize = pose.hasJoint.size();
-		for (int i = 0; i < jointSize; ++i) {
-			if (!pose.hasJoint[i]) continue;
+		if (pose.isEmpty()) continue;
+		for (int i = 0; i < Pose::JOINT_NUM; ++i) {
+			if (!pose.hasJoint(i)) continue;
 			Ink::Vec3 screen_pos = KR * (pose.jointPos[i] - camera->pos);
 			screen_pos /= screen_pos.z;
 			points[i].x = screen_pos.x;
@@ -73,7 +75,7 @@ void Visualizer2D::visualize(const MultiPersonPose& multiPersonPose,
 		};
 		
 		for (int i = 0; i < boneA.size(); ++i) {
-			if (pose.hasJoint[boneA[i]] && pose.hasJoint[boneB[i]]) {
+			if (pose.hasJoint(boneA[i]) && pose.hasJoint(boneB[i])) {
 				cv::line(image, points[boneA[i]], points[boneB[i]], color, 1);
 			}
 		}
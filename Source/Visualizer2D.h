@@ -27,5 +27,5 @@
 class Visualizer2D {
 public:
 	static void visualize(const MultiPersonPose& multiPersonPose,
-						  const View& view, const std::string& imagePath);
+						  const MultiView& multiview, int view, const std::string& imagePath);
 };
@@ -0,0 +1,247 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs tasks on a fixed set of threads, each owning a deque. An owner pushes
+ * and pops at the back, so it stays depth-first, while an idle thread steals
+ * from the front of another deque, where the oldest and usually largest
+ * pieces of work wait. Running tasks may push more tasks. The workers live
+ * as long as the pool and sleep between runs and while nothing is queued.
+ */
+template <typename T>
+class WorkStealingPool {
+public:
+	using Runner = std::function<void(T&, int)>;
+	
+	explicit WorkStealingPool(int threadNum);
+	
+	~WorkStealingPool();
+	
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+	
+	int getThreadNum() const;
+	
+	/* queues a task on the deque of thread, callable from a running task */
+	void push(int thread, T&& task);
+	
+	/* true while more threads wait than tasks are queued, running tasks should split only then */
+	bool isHungry() const;
+	
+	/* calls runner(task, thread) until every task, including the pushed ones, has finished */
+	void run(const Runner& runner);
+	
+private:
+	class Deque {
+	public:
+		std::mutex mutex;
+		
+		std::deque<T> tasks;
+	};
+	
+	std::vector<Deque> deques;
+	
+	std::vector<std::thread> workers;
+	
+	/* tasks queued or running, the pool is done once this reaches 0 */
+	std::atomic<int> pendingNum{0};
+	
+	std::atomic<int> queuedNum{0};
+	
+	std::atomic<int> idleNum{0};
+	
+	/* guards the fields below and the waits on the conditions */
+	std::mutex mutex;
+	
+	/* a run started or the pool is stopping */
+	std::condition_variable started;
+	
+	/* a task was queued or the run has no tasks left */
+	std::condition_variable queued;
+	
+	/* every worker has left the run */
+	std::condition_variable finished;
+	
+	const Runner* runner = nullptr;
+	
+	unsigned long long generation = 0;
+	
+	/* workers that have not left the current run yet */
+	int activeNum = 0;
+	
+	bool isStopping = false;
+	
+	bool pop(int thread, T& task);
+	
+	bool steal(int thread, T& task);
+	
+	void work(const Runner& runner, int thread);
+	
+	void wait(int thread);
+};
+
+template <typename T>
+WorkStealingPool<T>::WorkStealingPool(int threadNum) : deques(threadNum) {
+	workers.reserve(threadNum - 1);
+	for (int thread = 1; thread < threadNum; ++thread) {
+		workers.emplace_back(&WorkStealingPool<T>::wait, this, thread);
+	}
+}
+
+template <typename T>
+WorkStealingPool<T>::~WorkStealingPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	started.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+template <typename T>
+int WorkStealingPool<T>::getThreadNum() const {
+	return static_cast<int>(deques.size());
+}
+
+template <typename T>
+void WorkStealingPool<T>::push(int thread, T&& task) {
+	++pendingNum;
+	{
+		std::lock_guard<std::mutex> lock(deques[thread].mutex);
+		deques[thread].tasks.emplace_back(std::move(task));
+	}
+	++queuedNum;
+	
+	/* a thread parks only after it saw queuedNum at 0 with idleNum raised, so one of both sides sees the other */
+	if (idleNum.load() > 0) {
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.notify_one();
+	}
+}
+
+template <typename T>
+bool WorkStealingPool<T>::isHungry() const {
+	return idleNum.load(std::memory_order_relaxed) > queuedNum.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+bool WorkStealingPool<T>::pop(int thread, T& task) {
+	auto& deque = deques[thread];
+	std::lock_guard<std::mutex> lock(deque.mutex);
+	if (deque.tasks.empty()) return false;
+	task = std::move(deque.tasks.back());
+	deque.tasks.pop_back();
+	--queuedNum;
+	return true;
+}
+
+template <typename T>
+bool WorkStealingPool<T>::steal(int thread, T& task) {
+	int threadNum = getThreadNum();
+	for (int offset = 1; offset < threadNum; ++offset) {
+		auto& deque = deques[(thread + offset) % threadNum];
+		std::lock_guard<std::mutex> lock(deque.mutex);
+		if (deque.tasks.empty()) continue;
+		task = std::move(deque.tasks.front());
+		deque.tasks.pop_front();
+		--queuedNum;
+		return true;
+	}
+	return false;
+}
+
+template <typename T>
+void WorkStealingPool<T>::work(const Runner& runner, int thread) {
+	T task;
+	while (true) {
+		if (pop(thread, task) || steal(thread, task)) {
+			runner(task, thread);
+			if (--pendingNum == 0) {
+				std::lock_guard<std::mutex> lock(mutex);
+				queued.notify_all();
+			}
+			continue;
+		}
+		
+		/* nothing to take, sleep until a task is queued or the run is over */
+		std::unique_lock<std::mutex> lock(mutex);
+		++idleNum;
+		queued.wait(lock, [&]() -> bool {
+			return queuedNum.load() > 0 || pendingNum.load() == 0;
+		});
+		--idleNum;
+		if (pendingNum.load() == 0) return;
+	}
+}
+
+template <typename T>
+void WorkStealingPool<T>::wait(int thread) {
+	unsigned long long seenGeneration = 0;
+	while (true) {
+		const Runner* curRunner = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			started.wait(lock, [&]() -> bool {
+				return isStopping || generation != seenGeneration;
+			});
+			if (isStopping) return;
+			seenGeneration = generation;
+			curRunner = runner;
+		}
+		work(*curRunner, thread);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--activeNum == 0) finished.notify_all();
+	}
+}
+
+template <typename T>
+void WorkStealingPool<T>::run(const Runner& runner) {
+	if (pendingNum.load() == 0) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->runner = &runner;
+		activeNum = static_cast<int>(workers.size());
+		++generation;
+	}
+	started.notify_all();
+	work(runner, 0);
+	
+	/* every worker joins each run, so runner stays valid until the last one has left */
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&]() -> bool {
+		return activeNum == 0;
+	});
+	this->runner = nullptr;
+}
@@ -0,0 +1,190 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "LiveIngest.h"
+#include "FakePublisher.h"
+#include "4DALoader.h"
+#include "ShelfLoader.h"
+#include "SkeletonConverter.h"
+#include "MotionExport.h"
+
+#include <iostream>
+
+/* the QuickPose default of 0.1 is in meters, the pixel metric needs its own */
+constexpr float MAX_PIXEL_EPIPOLAR_DISTANCE = 25.f;
+
+/**
+ * Replays a 4DA dataset through the live ingest path, one fake publisher
+ * per camera, and reports what the frame assembler produced. Maximum bone
+ * lengths are learned from the ground truth in the Shelf layout, as in Main.
+ *
+ * Usage: LiveMain [dataset=../Dataset/shelf] [gt=dataset/gt.txt] [margin=0.1]
+ *                 [fps=25] [drop=0] [delay=0] [deadline=0.05]
+ *                 [bvh=path/prefix] [npy=path/name] [minconf=0] [nms=0] [topk=0]
+ *                 [seed=0] [metric=ray|pixel] [epipolar=0.1|25] [torso=0] [sparse=0] [half=0]
+ */
+
+int main(int argc, char** argv) {
+	std::string datasetPath = "../Dataset/shelf";
+	std::string socketPath = "/tmp/mmmocap-detections.sock";
+	std::string GTPath;
+	float boneLengthMargin = 0.1f;
+	float fps = 25;
+	float dropRate = 0;
+	float maxDelay = 0;
+	float deadline = 0.05f;
+	std::string BVHPrefix;
+	std::string NPYPath;
+	CandidateFilter candidateFilter;
+	float seedVoxelSize = 0;
+	EpipolarMetric epipolarMetric = EpipolarMetric::RAY;
+	float maxEpipolarDistance = 0;
+	bool isTorsoFirst = false;
+	float PAFThreshold = 0;
+	bool isHalfPAF = false;
+	
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		size_t split = argument.find('=');
+		if (split == std::string::npos) {
+			std::cerr << "LiveMain Error: Invalid argument " << argument << "\n";
+			return 1;
+		}
+		std::string key = argument.substr(0, split);
+		std::string value = argument.substr(split + 1);
+		if (key == "dataset") {
+			datasetPath = value;
+		} else if (key == "gt") {
+			GTPath = value;
+		} else if (key == "margin") {
+			boneLengthMargin = std::stof(value);
+		} else if (key == "socket") {
+			socketPath = value;
+		} else if (key == "fps") {
+			fps = std::stof(value);
+		} else if (key == "drop") {
+			dropRate = std::stof(value);
+		} else if (key == "delay") {
+			maxDelay = std::stof(value);
+		} else if (key == "deadline") {
+			deadline = std::stof(value);
+		} else if (key == "bvh") {
+			BVHPrefix = value;
+		} else if (key == "npy") {
+			NPYPath = value;
+		} else if (key == "minconf") {
+			candidateFilter.setMinConf(std::stof(value));
+		} else if (key == "nms") {
+			candidateFilter.setSuppressionRadius(std::stof(value));
+		} else if (key == "topk") {
+			candidateFilter.setMaxCandidateNum(std::stoi(value));
+		} else if (key == "seed") {
+			seedVoxelSize = std::stof(value);
+		} else if (key == "metric") {
+			epipolarMetric = value == "pixel" ? EpipolarMetric::PIXEL : EpipolarMetric::RAY;
+		} else if (key == "epipolar") {
+			maxEpipolarDistance = std::stof(value);
+		} else if (key == "torso") {
+			isTorsoFirst = std::stoi(value) != 0;
+		} else if (key == "sparse") {
+			PAFThreshold = std::stof(value);
+		} else if (key == "half") {
+			isHalfPAF = std::stoi(value) != 0;
+		} else {
+			std::cerr << "LiveMain Error: Unknown parameter " << key << "\n";
+			return 1;
+		}
+	}
+	
+	MultiViews multiviews = T4DALoader::loadDataset(datasetPath);
+	if (multiviews.empty()) return 1;
+	auto session = multiviews[0].session;
+	
+	QuickPose quickpose;
+	quickpose.initBody25();
+	quickpose.setSeedVoxelSize(seedVoxelSize);
+	if (maxEpipolarDistance <= 0 && epipolarMetric == EpipolarMetric::PIXEL) {
+		maxEpipolarDistance = MAX_PIXEL_EPIPOLAR_DISTANCE;
+	}
+	if (maxEpipolarDistance > 0) quickpose.setMaxEpipolarDistance(maxEpipolarDistance);
+	if (isTorsoFirst) quickpose.setTorsoJoints({8, 1, 2, 5, 9, 12});
+	
+	auto multiPersonPosesBones = T4DALoader::loadGroundTruth(GTPath.empty() ? datasetPath + "/gt.txt" : GTPath);
+	if (multiPersonPosesBones.empty()) return 1;
+	SkeletonConverter::shelfToBody25(multiPersonPosesBones);
+	auto boneConstraints = ShelfLoader::learnBoneConstraints(multiPersonPosesBones, quickpose.getParents());
+	boneConstraints.widen(boneLengthMargin);
+	quickpose.setBoneConstraints(boneConstraints);
+	
+	/* exporters stream from the ingest thread, so memory stays constant over long sessions */
+	BVHExporter BVHExport;
+	PoseArrayWriter NPYExport;
+	if (!BVHPrefix.empty() &&
+		!BVHExport.open(BVHPrefix, quickpose.getParents(), {}, 1.f / fps, BVHWriter::getBody25Names())) return 1;
+	if (!NPYPath.empty() && !NPYExport.open(NPYPath, session->typeNum, 16)) return 1;
+	
+	size_t personNum = 0;
+	std::atomic<size_t> processedNum = 0;
+	LiveIngest ingest(session);
+	ingest.getAssembler().setDeadline(deadline);
+	ingest.getAssembler().setSyncTolerance(static_cast<unsigned long long>(0.25e6f / fps));
+	ingest.setCandidateFilter(candidateFilter);
+	ingest.setEpipolarMetric(epipolarMetric);
+	ingest.setPAFCompression(PAFThreshold, isHalfPAF);
+	bool isStarted = ingest.start(socketPath, quickpose, [&](const MultiView& multiview, MultiPersonPose&& multiPersonPose) {
+		personNum += multiPersonPose.size();
+		if (!BVHPrefix.empty()) BVHExport.write(multiPersonPose);
+		if (!NPYPath.empty()) NPYExport.write(multiPersonPose);
+		std::cout << "frame " << multiview.timestamp << " persons " << multiPersonPose.size() << "\n";
+		++processedNum;
+	});
+	if (!isStarted) return 1;
+	
+	std::vector<std::thread> publishers;
+	for (int view = 0; view < session->viewNum; ++view) {
+		publishers.emplace_back([&, view]() -> void {
+			FakePublisher publisher;
+			if (!publisher.connect(socketPath)) return;
+			publisher.replay(multiviews, view, 1.f / fps, dropRate, maxDelay);
+		});
+	}
+	for (auto& publisher : publishers) {
+		publisher.join();
+	}
+	
+	/* let the assembler flush the remaining frames, the last one past its deadline */
+	auto& assembler = ingest.getAssembler();
+	size_t frameNum = 0;
+	do {
+		frameNum = assembler.getFrameNum();
+		std::this_thread::sleep_for(std::chrono::duration<float>(deadline * 2 + 0.1f));
+	} while (assembler.getFrameNum() != frameNum || processedNum != frameNum);
+	ingest.stop();
+	BVHExport.close();
+	NPYExport.close();
+	
+	std::cout << "frames " << assembler.getFrameNum() << " incomplete " << assembler.getIncompleteNum() <<
+		" dropped " << assembler.getDroppedNum() << " late " << assembler.getLateNum() <<
+		" persons " << personNum << " filtered candidates " << ingest.getDroppedCandidateNum() << "\n";
+	
+	return 0;
+}
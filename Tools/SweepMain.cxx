@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) 2022-2023 Hypertheory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SweepRunner.h"
+#include "QuickPose.h"
+#include "4DALoader.h"
+#include "ShelfLoader.h"
+#include "SkeletonConverter.h"
+#include "Parallel.h"
+
+#include <iostream>
+#include <sstream>
+
+/**
+ * Headless parameter sweep over the Shelf dataset. Configurations run one
+ * after another, threads sets the search threads of each.
+ *
+ * Usage: SweepMain [epipolar=0.05,0.1] [clusters=1000,100000] [persons=10]
+ *                  [affinity=0.0001] [margin=0.05,0.1] [threads=8]
+ */
+
+template <typename T>
+std::vector<T> parseList(const std::string& string) {
+	std::vector<T> values;
+	std::stringstream stream(string);
+	std::string token;
+	while (std::getline(stream, token, ',')) {
+		std::stringstream tokenStream(token);
+		T value;
+		tokenStream >> value;
+		values.emplace_back(value);
+	}
+	return values;
+}
+
+int main(int argc, char** argv) {
+	SweepGrid grid;
+	grid.maxEpipolarDistances = {0.05f, 0.1f, 0.15f};
+	grid.boneLengthMargins = {0.05f, 0.1f, 0.2f};
+	
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		size_t split = argument.find('=');
+		if (split == std::string::npos) {
+			std::cerr << "SweepMain Error: Invalid argument " << argument << "\n";
+			return 1;
+		}
+		std::string key = argument.substr(0, split);
+		std::string value = argument.substr(split + 1);
+		if (key == "epipolar") {
+			grid.maxEpipolarDistances = parseList<float>(value);
+		} else if (key == "clusters") {
+			grid.maxClusterNums = parseList<int>(value);
+		} else if (key == "persons") {
+			grid.maxPersonNums = parseList<int>(value);
+		} else if (key == "affinity") {
+			grid.minAffinities = parseList<float>(value);
+		} else if (key == "margin") {
+			grid.boneLengthMargins = parseList<float>(value);
+		} else if (key == "threads") {
+			Parallel::setThreadNum(std::stoi(value));
+		} else {
+			std::cerr << "SweepMain Error: Unknown parameter " << key << "\n";
+			return 1;
+		}
+	}
+	
+	Evaluator evaluator;
+	evaluator.initBody25();
+	evaluator.setIgnoredIDs({4});
+	
+	auto multiPersonPosesGT = ShelfLoader::loadGroundTruth("../Dataset/shelf/shelf.gt.txt");
+	SkeletonConverter::shelfToBody25(multiPersonPosesGT);
+	
+	/* only provides the Body25 bones the limits are learned for */
+	QuickPose skeleton;
+	skeleton.initBody25();
+	
+	/* maximum lengths only, learned from the 4DA ground truth in the Shelf layout */
+	auto multiPersonPosesBones = T4DALoader::loadGroundTruth("../Dataset/shelf/gt.txt");
+	SkeletonConverter::shelfToBody25(multiPersonPosesBones);
+	
+	SweepRunner runner;
+	runner.setDataset(T4DALoader::loadAffinities("../Dataset/shelf"));
+	runner.setGroundTruth(multiPersonPosesGT, 300);
+	runner.setBoneConstraints(ShelfLoader::learnBoneConstraints(multiPersonPosesBones, skeleton.getParents()));
+	runner.setEvaluator(evaluator);
+	runner.setPostProcess(SkeletonConverter::correctShelfAtBody25);
+	
+	std::cout << SweepRunner::toParetoTable(runner.run(grid));
+	
+	return 0;
+}